@@ -0,0 +1,34 @@
+// Calls into an Ether script from C++, and back into C++ from the script.
+#include <iostream>
+
+#include "engine/engine.hpp"
+
+static const char *Script = R"(
+#include "std/io.eth"
+
+i64 calls = 0;
+
+i64 scale(i64 x) { return syscall(1000, x); }
+
+i64 score(i64 a, i64 b) {
+    calls++;
+    return scale(a) + b;
+}
+
+i64 total_calls() { return calls; }
+)";
+
+int main() {
+    ether::Engine engine;
+    engine.register_function(1000, [](std::span<const ether::vm::Value> args) {
+        return ether::vm::Value(args[0].i64_value() * 10);
+    });
+    engine.load_source(Script, "embed.eth");
+
+    int64_t sum = 0;
+    for (int64_t i = 0; i < 1000; ++i) {
+        sum += engine.call("score", {ether::vm::Value(i), ether::vm::Value((int64_t)1)}).i64_value();
+    }
+    std::cout << "sum " << sum << ", calls " << engine.call("total_calls").i64_value() << std::endl;
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include "driver/bytecode_cache.hpp"
+
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+namespace ether::driver {
+
+namespace {
+
+std::optional<std::string> read_file(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return std::nullopt;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+fs::path cache_dir() {
+    if (const char *dir = std::getenv("ETHER_CACHE_DIR"); dir && *dir) return dir;
+    if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) return fs::path(xdg) / "ether";
+    if (const char *home = std::getenv("HOME"); home && *home) return fs::path(home) / ".cache" / "ether";
+    return {};
+}
+
+// Images are only reused by the same build of the compiler, since its output may change without the format
+// version doing so
+std::string compiler_stamp() {
+    struct stat st;
+    if (stat("/proc/self/exe", &st) != 0) return "";
+    return std::to_string(st.st_size) + ":" + std::to_string(st.st_mtim.tv_sec) + "." +
+           std::to_string(st.st_mtim.tv_nsec);
+}
+
+bool still_holds(const ir::SourceDependency &dep) {
+    std::error_code ec;
+    switch (dep.kind) {
+        case ir::DependencyKind::Content: {
+            auto content = read_file(dep.path);
+            return content && ir::hash_source(*content) == dep.hash;
+        }
+        case ir::DependencyKind::Absent:
+            return !fs::exists(dep.path, ec) && !ec;
+        case ir::DependencyKind::WorkingDirectory:
+            return fs::current_path(ec).string() == dep.path && !ec;
+        case ir::DependencyKind::Compiler:
+            return dep.path == compiler_stamp();
+    }
+    return false;
+}
+
+}  // namespace
+
+std::string cache_path_for(const std::string &source_path, bool optimize) {
+    fs::path dir = cache_dir();
+    if (dir.empty()) return "";
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec) return "";
+
+    std::string key = fs::absolute(source_path, ec).lexically_normal().string();
+    key += '\0';
+    key += optimize ? "O" : "O0";
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.ethc", (unsigned long long)ir::hash_source(key));
+    return (dir / name).string();
+}
+
+std::optional<ir::MappedImage> load_cached(const std::string &cache_path, const std::string &source) {
+    if (!fs::exists(cache_path)) return std::nullopt;
+    std::optional<ir::MappedImage> image;
+    try {
+        image.emplace(cache_path);
+    } catch (const std::exception &) {
+        return std::nullopt;
+    }
+    auto deps = image->dependencies();
+    if (deps.empty() || deps[0].hash != ir::hash_source(source)) return std::nullopt;
+    for (size_t i = 1; i < deps.size(); ++i) {
+        if (!still_holds(deps[i])) return std::nullopt;
+    }
+    return image;
+}
+
+void store_cached(const std::string &cache_path, const ir::BytecodeImage &image) {
+    try {
+        ir::write_bytecode_file(cache_path, image);
+    } catch (const std::exception &) {
+    }
+}
+
+std::vector<ir::SourceDependency> collect_dependencies(const std::string &filename, const std::string &source,
+                                                       const parser::Program &program) {
+    std::vector<ir::SourceDependency> deps;
+    deps.push_back({filename, ir::hash_source(source)});
+    std::unordered_set<std::string> seen;
+    bool used_working_dir = false;
+    for (const auto &include : program.includes) {
+        // A file created where the include looked first would take its place
+        if (!include->shadowed_path.empty()) {
+            used_working_dir = true;
+            if (seen.insert(include->shadowed_path).second) {
+                deps.push_back({include->shadowed_path, 0, ir::DependencyKind::Absent});
+            }
+        }
+        if (!seen.insert(include->path).second) continue;
+        auto content = read_file(include->path);
+        deps.push_back({include->path, content ? ir::hash_source(*content) : 0});
+    }
+    if (used_working_dir) {
+        std::error_code ec;
+        deps.push_back({fs::current_path(ec).string(), 0, ir::DependencyKind::WorkingDirectory});
+    }
+    deps.push_back({compiler_stamp(), 0, ir::DependencyKind::Compiler});
+    return deps;
+}
+
+}  // namespace ether::driver
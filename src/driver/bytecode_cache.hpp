@@ -0,0 +1,26 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ir/bytecode_file.hpp"
+#include "parser/ast.hpp"
+
+namespace ether::driver {
+
+// Where the compiled image of `source_path` is cached, or an empty string when there is no usable cache directory.
+// The directory is $ETHER_CACHE_DIR, else $XDG_CACHE_HOME/ether, else ~/.cache/ether. Each source has one entry per
+// optimization level, which every recompile overwrites, so the cache only grows with the number of sources.
+std::string cache_path_for(const std::string &source_path, bool optimize);
+// The cached image, if it exists and every file it was built from still has the same content
+std::optional<ir::MappedImage> load_cached(const std::string &cache_path, const std::string &source);
+// Never throws: a cache that cannot be written only costs the next run a compile
+void store_cached(const std::string &cache_path, const ir::BytecodeImage &image);
+
+// The main file and every file it included, hashed as they are now, plus what resolved includes against the working
+// directory relied on
+std::vector<ir::SourceDependency> collect_dependencies(const std::string &filename, const std::string &source,
+                                                       const parser::Program &program);
+
+}  // namespace ether::driver
@@ -84,6 +84,10 @@ void print_stats(const ether::vm::VM &vm, double total_ms, double lex_ms, double
     std::cout << std::left << std::setw(15) << "VM Run" << vm_ms << " ms" << std::endl;
     std::cout << std::string(30, '-') << std::endl;
     std::cout << std::left << std::setw(15) << "Total" << total_ms << " ms" << std::endl;
+    if (vm.output_dropped() > 0) {
+        std::cout << "Dropped " << vm.output_dropped() << " bytes of console output" << std::endl;
+    }
+    std::cout << "Cycle collector freed " << vm.cycles_freed() << " arrays" << std::endl;
 
     std::cout << "\nExecution Statistics (Sorted by Total Time):" << std::endl;
     std::cout << std::left << std::setw(15) << "OpCode" << std::setw(10) << "Count" << std::setw(15) << "Time (ms)"
@@ -122,9 +126,14 @@ void print_stats(const ether::vm::VM &vm, double total_ms, double lex_ms, double
 void print_usage() {
     std::cerr << "Usage: ether <command> [args]\n\n"
               << "Commands:\n"
-              << "  ether <filename> [flags]    Compile and run a source file\n"
+              << "  ether <filename> [flags]    Compile and run a source file, or run a .ethc image\n"
               << "      --dump-ir               Dump the generated bytecode\n"
-              << "      --stats                 Show execution statistics\n\n"
+              << "      --stats                 Show execution statistics\n"
+              << "      -O0                     Disable optimizations\n"
+              << "      --emit-bytecode <file>  Write the compiled program to a .ethc image instead of running it\n"
+              << "      --no-cache              Always compile, without reading or writing the bytecode cache\n"
+              << "      --output-policy <p>     When console output backs up: block (default) or drop\n"
+              << "      --output-buffer <bytes> Console output queued per stream (default 1048576)\n\n"
               << "  ether --test <path> [flags] Run tests\n"
               << "      -j <N>                  Number of parallel jobs\n"
               << "      -q, --quiet             Suppress output\n\n"
@@ -0,0 +1,31 @@
+#include "driver/vm_flags.hpp"
+
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+namespace ether::driver {
+
+bool parse_vm_flag(int argc, char *argv[], int &i, vm::VMOptions &options) {
+    std::string arg = argv[i];
+    if (arg == "--output-policy" && i + 1 < argc) {
+        std::string policy = argv[++i];
+        if (policy == "block") {
+            options.output_policy = vm::OutputPolicy::Block;
+        } else if (policy == "drop") {
+            options.output_policy = vm::OutputPolicy::Drop;
+        } else {
+            throw std::runtime_error("--output-policy must be 'block' or 'drop'");
+        }
+        return true;
+    }
+    if (arg == "--output-buffer" && i + 1 < argc) {
+        long long bytes = std::atoll(argv[++i]);
+        if (bytes <= 0) throw std::runtime_error("--output-buffer requires a positive size in bytes");
+        options.output_buffer = (size_t)bytes;
+        return true;
+    }
+    return false;
+}
+
+}  // namespace ether::driver
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "vm/vm.hpp"
+
+namespace ether::driver {
+
+// Handles the flags that configure the VM, shared by `ether` and `ether-run`. Returns whether argv[i] was one of
+// them, leaving i on its value; throws std::runtime_error when the value is invalid.
+bool parse_vm_flag(int argc, char *argv[], int &i, vm::VMOptions &options);
+
+}  // namespace ether::driver
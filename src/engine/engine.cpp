@@ -0,0 +1,86 @@
+#include "engine/engine.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "ir/ir_gen.hpp"
+#include "lexer/lexer.hpp"
+#include "opt/constant_folder.hpp"
+#include "opt/pass_manager.hpp"
+#include "parser/ast_cache.hpp"
+#include "parser/include_graph.hpp"
+#include "sema/analyzer.hpp"
+
+namespace ether {
+
+Engine::Engine(bool optimize, const vm::VMOptions &options)
+    : m_optimize(optimize), m_options(options), m_ast_cache(std::make_unique<parser::AstCache>()) {}
+
+Engine::~Engine() = default;
+
+void Engine::load_source(const std::string &source, const std::string &filename) {
+    lexer::Lexer lexer(source, filename);
+    auto tokens = lexer.tokenize();
+    auto program_ast = parser::parse_with_includes(tokens, filename, m_ast_cache.get());
+
+    sema::Analyzer analyzer;
+    analyzer.analyze(*program_ast);
+    if (m_optimize) {
+        opt::ConstantFolder folder;
+        folder.fold(*program_ast);
+    }
+
+    ir_gen::IRGenerator ir_gen(m_optimize, true);
+    ir::IRProgram program = ir_gen.generate(*program_ast);
+    if (m_optimize) {
+        opt::PassManager::standard().run(program);
+    }
+
+    m_vm.reset();
+    m_image.reset();
+    m_program = std::move(program);
+    start(ir::ProgramView::of(m_program));
+}
+
+void Engine::load_file(const std::string &path) {
+    if (path.ends_with(".ethc")) {
+        m_vm.reset();
+        m_program = {};
+        m_image.emplace(path);
+        start(m_image->view());
+        return;
+    }
+    std::ifstream file(path);
+    if (!file.is_open()) throw std::runtime_error("Could not open file: " + path);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    load_source(buffer.str(), path);
+}
+
+void Engine::start(const ir::ProgramView &view) {
+    m_vm = std::make_unique<vm::VM>(view, m_options);
+    for (const auto &[id, fn] : m_host_functions) m_vm->register_host_function(id, fn);
+    m_vm->run();
+}
+
+void Engine::register_function(int64_t id, vm::HostFunction fn) {
+    if (m_vm) m_vm->register_host_function(id, fn);
+    m_host_functions.emplace_back(id, std::move(fn));
+}
+
+const ir::IRProgram::FunctionInfo *Engine::find_function(const std::string &name) const {
+    if (m_image) return m_image->find_function(name);
+    auto it = m_program.functions.find(name);
+    if (it == m_program.functions.end() || it->second.entry_addr == ir::IRProgram::NativeCall) return nullptr;
+    return &it->second;
+}
+
+vm::Value Engine::call(const std::string &name, std::span<const vm::Value> args) {
+    if (!m_vm) throw std::runtime_error("No program loaded");
+    const auto *func = find_function(name);
+    if (!func) throw std::runtime_error("Undefined function: " + name);
+    return m_vm->call(*func, args);
+}
+
+}  // namespace ether
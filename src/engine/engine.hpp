@@ -0,0 +1,65 @@
+#ifndef ETHER_ENGINE_HPP
+#define ETHER_ENGINE_HPP
+
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+
+#include "ir/bytecode_file.hpp"
+#include "ir/ir.hpp"
+#include "vm/vm.hpp"
+
+namespace ether {
+
+namespace parser {
+class AstCache;
+}
+
+// Embeds Ether in a C++ program: loads a script once, then calls its functions as often as needed from the same
+// VM, with globals kept between calls. Scripts call back into the host with syscall(id, args...) for the ids
+// registered through register_function.
+//
+//     ether::Engine engine;
+//     engine.register_function(1000, [](auto args) { return ether::vm::Value(args[0].i64_value() * 2); });
+//     engine.load_source("i64 twice(i64 x) { return syscall(1000, x); }");
+//     ether::vm::Value four = engine.call("twice", {ether::vm::Value((int64_t)2)});
+class Engine {
+   public:
+    explicit Engine(bool optimize = true, const vm::VMOptions &options = {});
+    ~Engine();
+
+    // Compiles a script and runs its global initializers, replacing whatever was loaded before. Includes are
+    // resolved relative to `filename`. Throws CompilerError for invalid source.
+    void load_source(const std::string &source, const std::string &filename = "<script>");
+    // Loads a source file, or a .ethc image without compiling anything
+    void load_file(const std::string &path);
+
+    // Host functions survive reloading; ids start at vm::HostSyscallBase
+    void register_function(int64_t id, vm::HostFunction fn);
+
+    bool has_function(const std::string &name) const { return find_function(name) != nullptr; }
+    // Throws std::runtime_error when the function does not exist, or when the script fails while running
+    vm::Value call(const std::string &name, std::span<const vm::Value> args = {});
+    vm::Value call(const std::string &name, std::initializer_list<vm::Value> args) {
+        return call(name, std::span<const vm::Value>(args.begin(), args.size()));
+    }
+
+   private:
+    const ir::IRProgram::FunctionInfo *find_function(const std::string &name) const;
+    void start(const ir::ProgramView &view);
+
+    bool m_optimize;
+    vm::VMOptions m_options;
+    std::vector<std::pair<int64_t, vm::HostFunction>> m_host_functions;
+    // One of the two holds the loaded program, which must outlive the VM running it
+    ir::IRProgram m_program;
+    std::optional<ir::MappedImage> m_image;
+    std::unique_ptr<vm::VM> m_vm;
+    // Included files parsed by earlier loads, so reloading a script only re-parses what changed
+    std::unique_ptr<parser::AstCache> m_ast_cache;
+};
+
+}  // namespace ether
+
+#endif  // ETHER_ENGINE_HPP
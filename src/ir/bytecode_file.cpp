@@ -0,0 +1,302 @@
+#include "bytecode_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace ether::ir {
+
+static_assert(std::endian::native == std::endian::little, "bytecode images are stored in host byte order");
+
+namespace {
+
+struct Section {
+    uint64_t offset;
+    uint64_t size;  // In bytes
+};
+
+constexpr uint32_t FlagOptimized = 1;
+
+struct ImageHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t num_globals;
+    uint64_t main_addr;
+    uint32_t main_slots;
+    uint32_t reserved;
+    Section dependencies;    // DependencyRecord[]
+    Section bytecode;        // uint8_t[]
+    Section string_data;     // char[]
+    Section strings;         // StringPool::Entry[]
+    Section function_table;  // IRProgram::FunctionInfo[]
+    Section functions;       // NamedFunction[], sorted by name for lookups and reproducible images
+    Section text;            // Dependency paths and function names
+};
+
+struct DependencyRecord {
+    uint64_t hash;
+    uint32_t path_offset;
+    uint32_t path_length;
+    DependencyKind kind;
+    uint32_t reserved;
+};
+
+struct NamedFunction {
+    uint32_t name_offset;
+    uint32_t name_length;
+    IRProgram::FunctionInfo info;
+};
+
+static_assert(std::is_trivially_copyable_v<IRProgram::FunctionInfo> && sizeof(IRProgram::FunctionInfo) == 16,
+              "function records are mapped in place");
+constexpr size_t SectionAlign = alignof(uint64_t);
+
+// Copies the fields alone, so the padding written to disk is always zero
+IRProgram::FunctionInfo function_record(const IRProgram::FunctionInfo &info) {
+    IRProgram::FunctionInfo record;
+    std::memset(&record, 0, sizeof(record));
+    record.entry_addr = info.entry_addr;
+    record.num_params = info.num_params;
+    record.num_slots = info.num_slots;
+    return record;
+}
+
+class ImageWriter {
+   public:
+    ImageWriter() : m_data(sizeof(ImageHeader), '\0') {}
+
+    Section add(const void *bytes, size_t size) {
+        m_data.resize((m_data.size() + SectionAlign - 1) / SectionAlign * SectionAlign, '\0');
+        Section section{m_data.size(), size};
+        m_data.append((const char *)bytes, size);
+        return section;
+    }
+    template <typename T>
+    Section add(const std::vector<T> &records) {
+        return add(records.data(), records.size() * sizeof(T));
+    }
+    void set_header(const ImageHeader &header) { std::memcpy(m_data.data(), &header, sizeof(header)); }
+    const std::string &data() const { return m_data; }
+
+   private:
+    std::string m_data;
+};
+
+}  // namespace
+
+uint64_t hash_source(std::string_view source) {
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : source) {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+void write_bytecode_file(const std::string &path, const BytecodeImage &image) {
+    const IRProgram &program = image.program;
+    ImageWriter out;
+    ImageHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, BytecodeMagic, sizeof(header.magic));
+    header.version = BytecodeVersion;
+    header.flags = image.optimized ? FlagOptimized : 0;
+    header.num_globals = program.num_globals;
+    header.main_addr = program.main_addr;
+    auto main_it = program.functions.find("main");
+    if (main_it != program.functions.end()) header.main_slots = main_it->second.num_slots;
+
+    std::string text;
+    auto add_text = [&](std::string_view str) {
+        uint32_t offset = (uint32_t)text.size();
+        text.append(str);
+        return offset;
+    };
+
+    std::vector<DependencyRecord> deps;
+    for (const auto &dep : image.dependencies) {
+        deps.push_back({dep.hash, add_text(dep.path), (uint32_t)dep.path.size(), dep.kind, 0});
+    }
+    std::vector<const std::pair<const std::string, IRProgram::FunctionInfo> *> by_name;
+    for (const auto &entry : program.functions) by_name.push_back(&entry);
+    std::sort(by_name.begin(), by_name.end(), [](const auto *a, const auto *b) { return a->first < b->first; });
+    std::vector<NamedFunction> functions;
+    for (const auto *entry : by_name) {
+        functions.push_back({add_text(entry->first), (uint32_t)entry->first.size(), function_record(entry->second)});
+    }
+    std::vector<IRProgram::FunctionInfo> table;
+    for (const auto &info : program.function_table) table.push_back(function_record(info));
+
+    header.dependencies = out.add(deps);
+    header.bytecode = out.add(program.bytecode);
+    header.string_data = out.add(program.string_pool.data.data(), program.string_pool.data.size());
+    header.strings = out.add(program.string_pool.entries);
+    header.function_table = out.add(table);
+    header.functions = out.add(functions);
+    header.text = out.add(text.data(), text.size());
+    out.set_header(header);
+
+    // Written aside and renamed into place, so a concurrent reader never sees half an image
+    std::string tmp_path = path + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) throw std::runtime_error("Could not write bytecode file: " + path);
+        file.write(out.data().data(), (std::streamsize)out.data().size());
+        if (!file) {
+            std::remove(tmp_path.c_str());
+            throw std::runtime_error("Could not write bytecode file: " + path);
+        }
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        throw std::runtime_error("Could not write bytecode file: " + path);
+    }
+}
+
+MappedImage::MappedImage(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw std::runtime_error("Could not open bytecode file: " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ImageHeader)) {
+        close(fd);
+        throw std::runtime_error("Invalid bytecode file " + path + ": not an ether bytecode image");
+    }
+    void *data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) throw std::runtime_error("Could not map bytecode file: " + path);
+    m_data = (const uint8_t *)data;
+    m_size = (size_t)st.st_size;
+    try {
+        validate(path);
+    } catch (...) {
+        munmap(data, m_size);
+        throw;
+    }
+}
+
+MappedImage::~MappedImage() {
+    if (m_data) munmap((void *)m_data, m_size);
+}
+
+MappedImage::MappedImage(MappedImage &&other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)), m_view(other.m_view) {}
+
+MappedImage &MappedImage::operator=(MappedImage &&other) noexcept {
+    std::swap(m_data, other.m_data);
+    std::swap(m_size, other.m_size);
+    std::swap(m_view, other.m_view);
+    return *this;
+}
+
+void MappedImage::validate(const std::string &path) {
+    auto fail = [&](const std::string &why) {
+        throw std::runtime_error("Invalid bytecode file " + path + ": " + why);
+    };
+    const auto &header = *(const ImageHeader *)m_data;
+    if (std::memcmp(header.magic, BytecodeMagic, sizeof(header.magic)) != 0) fail("not an ether bytecode image");
+    if (header.version != BytecodeVersion) {
+        fail("format version " + std::to_string(header.version) + ", expected " + std::to_string(BytecodeVersion));
+    }
+
+    auto section = [&]<typename T>(const Section &sec, const T *) {
+        if (sec.offset > m_size || sec.size > m_size - sec.offset || sec.offset % alignof(T) != 0 ||
+            sec.size % sizeof(T) != 0) {
+            fail("section out of range");
+        }
+        return std::span<const T>((const T *)(m_data + sec.offset), sec.size / sizeof(T));
+    };
+    auto bytecode = section(header.bytecode, (const uint8_t *)nullptr);
+    auto string_data = section(header.string_data, (const char *)nullptr);
+    auto strings = section(header.strings, (const StringPool::Entry *)nullptr);
+    auto table = section(header.function_table, (const IRProgram::FunctionInfo *)nullptr);
+    auto text = section(header.text, (const char *)nullptr);
+    for (const auto &dep : section(header.dependencies, (const DependencyRecord *)nullptr)) {
+        if ((uint64_t)dep.path_offset + dep.path_length > text.size()) fail("dependency out of range");
+        if (dep.kind > DependencyKind::Compiler) fail("unknown dependency kind");
+    }
+    for (const auto &func : section(header.functions, (const NamedFunction *)nullptr)) {
+        if ((uint64_t)func.name_offset + func.name_length > text.size()) fail("function name out of range");
+    }
+    for (const auto &entry : strings) {
+        if ((uint64_t)entry.offset + entry.length > string_data.size()) fail("string out of range");
+    }
+    for (const auto &info : table) {
+        if (info.entry_addr >= bytecode.size()) fail("function entry out of range");
+    }
+    if (header.main_addr > bytecode.size()) fail("entry point out of range");
+
+    m_view.bytecode = bytecode;
+    m_view.string_pool = {std::string_view(string_data.data(), string_data.size()), strings};
+    m_view.function_table = table;
+    m_view.main_addr = header.main_addr;
+    m_view.main_slots = header.main_slots;
+    m_view.num_globals = header.num_globals;
+}
+
+namespace {
+
+const ImageHeader &header_of(const uint8_t *data) { return *(const ImageHeader *)data; }
+
+std::string_view text_at(const uint8_t *data, uint32_t offset, uint32_t length) {
+    return std::string_view((const char *)data + header_of(data).text.offset + offset, length);
+}
+
+}  // namespace
+
+bool MappedImage::optimized() const { return header_of(m_data).flags & FlagOptimized; }
+
+std::vector<SourceDependency> MappedImage::dependencies() const {
+    const Section &sec = header_of(m_data).dependencies;
+    std::span<const DependencyRecord> records((const DependencyRecord *)(m_data + sec.offset),
+                                              sec.size / sizeof(DependencyRecord));
+    std::vector<SourceDependency> deps;
+    for (const auto &record : records) {
+        deps.push_back(
+            {std::string(text_at(m_data, record.path_offset, record.path_length)), record.hash, record.kind});
+    }
+    return deps;
+}
+
+const IRProgram::FunctionInfo *MappedImage::find_function(std::string_view name) const {
+    const Section &sec = header_of(m_data).functions;
+    std::span<const NamedFunction> functions((const NamedFunction *)(m_data + sec.offset),
+                                             sec.size / sizeof(NamedFunction));
+    auto name_of = [&](const NamedFunction &func) { return text_at(m_data, func.name_offset, func.name_length); };
+    auto it = std::lower_bound(functions.begin(), functions.end(), name,
+                               [&](const NamedFunction &func, std::string_view key) { return name_of(func) < key; });
+    if (it == functions.end() || name_of(*it) != name) return nullptr;
+    return &it->info;
+}
+
+IRProgram MappedImage::to_program() const {
+    IRProgram program;
+    program.bytecode.assign(m_view.bytecode.begin(), m_view.bytecode.end());
+    program.string_pool.data = std::string(m_view.string_pool.data);
+    program.string_pool.entries.assign(m_view.string_pool.entries.begin(), m_view.string_pool.entries.end());
+    program.function_table.assign(m_view.function_table.begin(), m_view.function_table.end());
+    program.main_addr = m_view.main_addr;
+    program.num_globals = m_view.num_globals;
+
+    const Section &sec = header_of(m_data).functions;
+    std::span<const NamedFunction> functions((const NamedFunction *)(m_data + sec.offset),
+                                             sec.size / sizeof(NamedFunction));
+    for (const auto &func : functions) {
+        program.functions[std::string(text_at(m_data, func.name_offset, func.name_length))] = func.info;
+    }
+    return program;
+}
+
+}  // namespace ether::ir
@@ -0,0 +1,68 @@
+#ifndef ETHER_IR_BYTECODE_FILE_HPP
+#define ETHER_IR_BYTECODE_FILE_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ir.hpp"
+
+namespace ether::ir {
+
+// Compiled programs saved as .ethc images. The layout is little-endian and versioned; a reader refuses any version
+// other than its own, so the format can change freely between releases.
+constexpr char BytecodeMagic[4] = {'E', 'T', 'H', 'C'};
+constexpr uint32_t BytecodeVersion = 4;
+
+// What the image was compiled from. Mostly source files, with the hash of the content they had at the time; an
+// include that fell back to the working directory also depends on that directory and on the file it looked for first
+// still being absent. A Compiler dependency names the build of the compiler that produced the image, in its path.
+enum class DependencyKind : uint32_t { Content, Absent, WorkingDirectory, Compiler };
+
+struct SourceDependency {
+    std::string path;
+    uint64_t hash = 0;
+    DependencyKind kind = DependencyKind::Content;
+};
+
+struct BytecodeImage {
+    IRProgram program;
+    bool optimized = true;
+    std::vector<SourceDependency> dependencies;  // The main file first, then every included file and what it needs
+};
+
+uint64_t hash_source(std::string_view source);
+
+void write_bytecode_file(const std::string &path, const BytecodeImage &image);
+
+// A bytecode image mapped read-only into memory. Every section is stored aligned and in its in-memory layout, so
+// the VM runs straight from the mapping and processes running the same image share its pages.
+class MappedImage {
+   public:
+    // Throws std::runtime_error when the file cannot be mapped or is not an image of this version
+    explicit MappedImage(const std::string &path);
+    ~MappedImage();
+    MappedImage(MappedImage &&other) noexcept;
+    MappedImage(const MappedImage &) = delete;
+    MappedImage &operator=(const MappedImage &) = delete;
+    MappedImage &operator=(MappedImage &&other) noexcept;
+
+    const ProgramView &view() const { return m_view; }
+    bool optimized() const;
+    std::vector<SourceDependency> dependencies() const;
+    const IRProgram::FunctionInfo *find_function(std::string_view name) const;
+    // Copies the image out into a regular program, for the tools that need more than the VM does
+    IRProgram to_program() const;
+
+   private:
+    void validate(const std::string &path);
+
+    const uint8_t *m_data = nullptr;
+    size_t m_size = 0;
+    ProgramView m_view;
+};
+
+}  // namespace ether::ir
+
+#endif  // ETHER_IR_BYTECODE_FILE_HPP
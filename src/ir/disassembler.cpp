@@ -6,6 +6,7 @@
 #include <unordered_map>
 
 #include "common/iter.hpp"
+#include "ir/syscalls.hpp"
 
 namespace ether::ir {
 
@@ -36,11 +37,7 @@ static void printLiteral(const std::string_view &texto) {
 void disassemble(const IRProgram &program) {
     std::cout << "Bytecode Size: " << program.bytecode.size() << " bytes" << std::endl;
     std::cout << "String Pool Size: " << program.string_pool.size() << " entries ";
-    size_t string_pool_size = 0;
-    for (auto &str : program.string_pool) {
-        string_pool_size += str.size();
-    }
-    std::cout << "(" << string_pool_size << " bytes)" << std::endl;
+    std::cout << "(" << program.string_pool.data.size() << " bytes)" << std::endl;
     std::cout << "Functions:" << std::endl;
     for_each_sorted(
         program.functions, [](const auto &a, const auto &b) { return a.second.entry_addr > b.second.entry_addr; },
@@ -118,7 +115,8 @@ void disassemble(const IRProgram &program) {
                 break;
             }
             case OpCode::STR_GET:
-            case OpCode::STR_SET: {
+            case OpCode::STR_SET:
+            case OpCode::LOAD_BYTE: {
                 break;
             }
             case OpCode::ARR_ALLOC: {
@@ -135,8 +133,18 @@ void disassemble(const IRProgram &program) {
                 std::cout << "slots " << slots;
                 break;
             }
+            case OpCode::FRAME_ALLOC: {
+                uint16_t slot = *(uint16_t *)&code[ip];
+                ip += 2;
+                uint32_t slots = *(uint32_t *)&code[ip];
+                ip += 4;
+                std::cout << "slot " << slot << " slots " << slots;
+                break;
+            }
             case OpCode::STORE_VAR:
-            case OpCode::LOAD_VAR: {
+            case OpCode::LOAD_VAR:
+            case OpCode::LOAD_VAR_BORROW:
+            case OpCode::LOAD_VAR_MOVE: {
                 uint16_t slot = *(uint16_t *)&code[ip];
                 ip += 2;
                 std::cout << "slot " << (int)slot;
@@ -156,6 +164,13 @@ void disassemble(const IRProgram &program) {
                 std::cout << "offset " << (int)offset;
                 break;
             }
+            case OpCode::LOAD_INDEX:
+            case OpCode::INDEX_ADDR: {
+                uint16_t elem_slots = *(uint16_t *)&code[ip];
+                ip += 2;
+                std::cout << "elem_slots " << (int)elem_slots;
+                break;
+            }
             case OpCode::SYSCALL: {
                 uint8_t num_args = code[ip++];
                 std::cout << "args ";
@@ -166,10 +181,25 @@ void disassemble(const IRProgram &program) {
                 }
                 break;
             }
+            case OpCode::SYSCALL_N: {
+                uint16_t index = *(uint16_t *)&code[ip];
+                ip += 2;
+                uint8_t num_args = code[ip++];
+                std::cout << (index < Syscalls.size() ? Syscalls[index].name : "?") << " args ";
+                if (num_args & 0x80) {
+                    std::cout << (num_args & 0x7F) << " (variadic)";
+                } else {
+                    std::cout << (int)num_args;
+                }
+                break;
+            }
             case OpCode::CALL:
+            case OpCode::TAIL_CALL:
             case OpCode::SPAWN: {
-                uint32_t target = *(uint32_t *)&code[ip];
+                uint32_t index = *(uint32_t *)&code[ip];
                 ip += 4;
+                size_t target = index < program.function_table.size() ? program.function_table[index].entry_addr
+                                                                       : (size_t)index;
                 uint8_t num_args = code[ip++];
                 std::cout << "addr " << target << " args ";
                 if (num_args & 0x80) {
@@ -189,7 +219,8 @@ void disassemble(const IRProgram &program) {
                 break;
             }
             case OpCode::JMP:
-            case OpCode::JZ: {
+            case OpCode::JZ:
+            case OpCode::JNZ: {
                 uint32_t target = *(uint32_t *)&code[ip];
                 ip += 4;
                 std::cout << "addr " << target;
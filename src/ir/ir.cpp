@@ -1,5 +1,8 @@
 #include "ir.hpp"
 
+#include <algorithm>
+#include <numeric>
+
 namespace ether::ir {
 
 std::ostream &operator<<(std::ostream &os, OpCode op) {
@@ -28,6 +31,7 @@ std::ostream &operator<<(std::ostream &os, OpCode op) {
         {OpCode::ARR_ALLOC, "ARR_ALLOC"},
         {OpCode::STRUCT_ALLOC, "STRUCT_ALLOC"},
         {OpCode::SYSCALL, "SYSCALL"},
+        {OpCode::SYSCALL_N, "SYSCALL_N"},
         {OpCode::CALL, "CALL"},
         {OpCode::JMP, "JMP"},
         {OpCode::JZ, "JZ"},
@@ -50,6 +54,14 @@ std::ostream &operator<<(std::ostream &os, OpCode op) {
         {OpCode::STORE_GLOBAL, "STORE_GLOBAL"},
         {OpCode::LOAD_PTR_OFFSET, "LOAD_PTR_OFFSET"},
         {OpCode::STORE_PTR_OFFSET, "STORE_PTR_OFFSET"},
+        {OpCode::LOAD_BYTE, "LOAD_BYTE"},
+        {OpCode::JNZ, "JNZ"},
+        {OpCode::LOAD_INDEX, "LOAD_INDEX"},
+        {OpCode::INDEX_ADDR, "INDEX_ADDR"},
+        {OpCode::TAIL_CALL, "TAIL_CALL"},
+        {OpCode::FRAME_ALLOC, "FRAME_ALLOC"},
+        {OpCode::LOAD_VAR_BORROW, "LOAD_VAR_BORROW"},
+        {OpCode::LOAD_VAR_MOVE, "LOAD_VAR_MOVE"},
     };
     auto it = op_to_str.find(op);
     if (it != op_to_str.end()) {
@@ -60,4 +72,47 @@ std::ostream &operator<<(std::ostream &os, OpCode op) {
     return os;
 }
 
+ProgramView ProgramView::of(const IRProgram &program) {
+    ProgramView view;
+    view.bytecode = program.bytecode;
+    view.string_pool = {program.string_pool.data, program.string_pool.entries};
+    view.function_table = program.function_table;
+    view.main_addr = program.main_addr;
+    auto main_it = program.functions.find("main");
+    if (main_it != program.functions.end()) view.main_slots = main_it->second.num_slots;
+    view.num_globals = program.num_globals;
+    return view;
+}
+
+StringPool StringPool::build(const std::vector<std::string_view> &strings) {
+    StringPool pool;
+    pool.entries.resize(strings.size());
+
+    // Ordered by their reversed text, the strings ending in some string s directly follow it. Walking that order
+    // backwards, s only has to be compared with the string placed just before it.
+    std::vector<uint32_t> order(strings.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return std::lexicographical_compare(strings[a].rbegin(), strings[a].rend(), strings[b].rbegin(),
+                                            strings[b].rend());
+    });
+
+    const std::string_view *prev = nullptr;
+    Entry prev_entry{0, 0};
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        std::string_view str = strings[*it];
+        Entry entry;
+        if (prev && prev->ends_with(str)) {
+            entry = {prev_entry.offset + prev_entry.length - (uint32_t)str.size(), (uint32_t)str.size()};
+        } else {
+            entry = {(uint32_t)pool.data.size(), (uint32_t)str.size()};
+            pool.data.append(str);
+        }
+        pool.entries[*it] = entry;
+        prev = &strings[*it];
+        prev_entry = entry;
+    }
+    return pool;
+}
+
 }  // namespace ether::ir
@@ -4,7 +4,9 @@
 #include <cstdint>
 #include <iostream>
 #include <ostream>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -40,7 +42,7 @@ enum class OpCode : uint8_t {
     ARR_ALLOC,         // [uint8_t opcode] [u32 count] [u32 elem_slots]
     STRUCT_ALLOC,      // [uint8_t opcode] [u32 slots]
     SYSCALL,           // [uint8_t opcode] [u8 num_args] (2 bytes)
-    CALL,              // [uint8_t opcode] [u32 target_addr] [u8 num_args] (6 bytes)
+    CALL,              // [uint8_t opcode] [u32 func_index] [u8 num_args] (6 bytes)
     JMP,               // [uint8_t opcode] [u32 target_addr] (5 bytes)
     JZ,                // [uint8_t opcode] [u32 target_addr] (5 bytes)
     CMP_EQ,            // [uint8_t opcode] (1 byte)
@@ -53,7 +55,7 @@ enum class OpCode : uint8_t {
     CMP_LT_F,          // [uint8_t opcode] (1 byte)
     CMP_GT_F,          // [uint8_t opcode] (1 byte)
     CMP_GE_F,          // [uint8_t opcode] (1 byte)
-    SPAWN,             // [uint8_t opcode] [u32 target_addr] [u8 num_args] (6 bytes)
+    SPAWN,             // [uint8_t opcode] [u32 func_index] [u8 num_args] (6 bytes)
     YIELD,             // [uint8_t opcode] (1 byte)
     AWAIT,             // [uint8_t opcode] (1 byte)
     POP,               // [uint8_t opcode] (1 byte)
@@ -62,23 +64,79 @@ enum class OpCode : uint8_t {
     STORE_GLOBAL,      // [uint8_t opcode] [u16 slot] (3 bytes)
     LOAD_PTR_OFFSET,   // [uint8_t opcode] [i32 offset] (5 bytes)
     STORE_PTR_OFFSET,  // [uint8_t opcode] [i32 offset] (5 bytes)
+    LOAD_BYTE,         // [uint8_t opcode] (1 byte) -- pops (bytes, index) -> pushes i8
+    JNZ,               // [uint8_t opcode] [u32 target_addr] (5 bytes)
+    LOAD_INDEX,        // [uint8_t opcode] [u16 elem_slots] (3 bytes) -- pops (ptr, index) -> pushes ptr[index]
+    INDEX_ADDR,        // [uint8_t opcode] [u16 elem_slots] (3 bytes) -- pops (ptr, index) -> pushes &ptr[index]
+    TAIL_CALL,         // [uint8_t opcode] [u32 func_index] [u8 num_args] (6 bytes) -- CALL that replaces the frame
+    FRAME_ALLOC,       // [uint8_t opcode] [u16 slot] [u32 slots] (7 bytes) -- zeroes frame slots, pushes ptr to them
+    LOAD_VAR_BORROW,   // [uint8_t opcode] [u16 slot] (3 bytes) -- LOAD_VAR without taking a reference
+    LOAD_VAR_MOVE,     // [uint8_t opcode] [u16 slot] (3 bytes) -- LOAD_VAR of a last use, leaving the slot empty
+    SYSCALL_N,         // [uint8_t opcode] [u16 syscall_index] [u8 num_args] (4 bytes) -- SYSCALL of a known built-in,
+                       // by its index in ir::Syscalls, without the id on the stack
+};
+
+// The string literals of a program, stored back to back in one buffer. A literal that ends another one points into
+// its tail instead of taking space of its own.
+struct StringPool {
+    struct Entry {
+        uint32_t offset;
+        uint32_t length;
+    };
+    std::string data;
+    std::vector<Entry> entries;  // Indexed by the PUSH_STR operand
+
+    size_t size() const { return entries.size(); }
+    std::string_view operator[](size_t id) const {
+        return std::string_view(data).substr(entries[id].offset, entries[id].length);
+    }
+    void clear() {
+        data.clear();
+        entries.clear();
+    }
+    // Lays out distinct strings, indexed by id, sharing common suffixes
+    static StringPool build(const std::vector<std::string_view> &strings);
 };
 
 struct IRProgram {
     std::vector<uint8_t> bytecode;
-    std::vector<std::string> string_pool;
+    StringPool string_pool;
 
     struct FunctionInfo {
         size_t entry_addr;
         uint8_t num_params;
         uint32_t num_slots;
     };
+    // SPAWN operand for `spawn syscall(...)`, which runs the syscall as its own coroutine
+    static constexpr uint32_t NativeCall = 0xFFFFFFFF;
+
     std::unordered_map<std::string, FunctionInfo> functions;
-    std::unordered_map<size_t, FunctionInfo> addr_to_info;  // Fast lookup
+    std::vector<FunctionInfo> function_table;  // Indexed by the CALL/SPAWN operand, in entry address order
     size_t main_addr = 0;
     uint32_t num_globals = 0;
 };
 
+// A read-only StringPool whose storage is owned elsewhere
+struct StringPoolView {
+    std::string_view data;
+    std::span<const StringPool::Entry> entries;
+
+    size_t size() const { return entries.size(); }
+    std::string_view operator[](size_t id) const { return data.substr(entries[id].offset, entries[id].length); }
+};
+
+// The parts of a program the VM runs from, pointing into an IRProgram or straight into a mapped bytecode image
+struct ProgramView {
+    std::span<const uint8_t> bytecode;
+    StringPoolView string_pool;
+    std::span<const IRProgram::FunctionInfo> function_table;
+    size_t main_addr = 0;
+    uint32_t main_slots = 0;
+    uint32_t num_globals = 0;
+
+    static ProgramView of(const IRProgram &program);
+};
+
 std::ostream &operator<<(std::ostream &os, OpCode op);
 
 }  // namespace ether::ir
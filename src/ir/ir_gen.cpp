@@ -1,5 +1,6 @@
 #include "ir_gen.hpp"
 
+#include <algorithm>
 #include <cstring>
 
 #include "ir/dependency_tracker.hpp"
@@ -9,8 +10,10 @@ namespace ether::ir_gen {
 ir::IRProgram IRGenerator::generate(const parser::Program &ast) {
     m_program.bytecode.clear();
     m_program.string_pool.clear();
+    m_string_ids.clear();
+    m_strings.clear();
     m_program.functions.clear();
-    m_program.addr_to_info.clear();
+    m_program.function_table.clear();
     m_call_patches.clear();
     m_reachable.clear();
     m_scopes.clear();
@@ -31,6 +34,9 @@ ir::IRProgram IRGenerator::generate(const parser::Program &ast) {
 
     DependencyTracker tracker(all_funcs, all_globals_map);
     tracker.trace("main");
+    if (m_library) {
+        for (const auto &[name, func] : all_funcs) tracker.trace(name);
+    }
     m_reachable = std::move(tracker.reachable);
 
     // 2. Collect struct layouts
@@ -68,7 +74,9 @@ ir::IRProgram IRGenerator::generate(const parser::Program &ast) {
             m_program.functions[name] = {0, (uint8_t)func->params.size(), 0};
         }
     }
-    m_program.functions["syscall"] = {0xFFFFFFFF, 0, 0};
+    m_program.functions["syscall"] = {ir::IRProgram::NativeCall, 0, 0};
+    collect_inline_candidates(all_funcs);
+    analyze_escapes(all_funcs);
 
     // 4. Entry point / Global initialization
     m_program.main_addr = 0;
@@ -81,9 +89,13 @@ ir::IRProgram IRGenerator::generate(const parser::Program &ast) {
     }
 
     // Call main and halt
-    size_t patch_pos = m_program.bytecode.size() + 1;
-    m_call_patches.push_back({patch_pos, "main"});
-    emit_call(0, 0);
+    if (m_library) {
+        emit_push_i32(0);
+    } else {
+        size_t patch_pos = m_program.bytecode.size() + 1;
+        m_call_patches.push_back({patch_pos, "main"});
+        emit_call(0, 0);
+    }
     emit_halt();
 
     // 5. Generate functions
@@ -91,15 +103,26 @@ ir::IRProgram IRGenerator::generate(const parser::Program &ast) {
 
     emit_halt();
 
-    for (const auto &patch : m_call_patches) {
-        uint32_t addr = (uint32_t)m_program.functions.at(patch.func_name).entry_addr;
-        std::memcpy(&m_program.bytecode[patch.pos], &addr, 4);
+    // 6. Link: number the functions and point every call at its function table entry, so the VM gets the callee's
+    // frame layout with an index instead of a hash lookup
+    std::vector<const std::pair<const std::string, ir::IRProgram::FunctionInfo> *> ordered;
+    for (const auto &entry : m_program.functions) {
+        if (entry.second.entry_addr != ir::IRProgram::NativeCall) ordered.push_back(&entry);
+    }
+    std::sort(ordered.begin(), ordered.end(),
+              [](const auto *a, const auto *b) { return a->second.entry_addr < b->second.entry_addr; });
+    std::unordered_map<std::string_view, uint32_t> func_index;
+    for (const auto *entry : ordered) {
+        func_index[entry->first] = (uint32_t)m_program.function_table.size();
+        m_program.function_table.push_back(entry->second);
     }
 
-    for (const auto &[name, info] : m_program.functions) {
-        m_program.addr_to_info[info.entry_addr] = info;
+    for (const auto &patch : m_call_patches) {
+        uint32_t index = func_index.at(patch.func_name);
+        std::memcpy(&m_program.bytecode[patch.pos], &index, 4);
     }
 
+    m_program.string_pool = ir::StringPool::build(m_strings);
     return std::move(m_program);
 }
 
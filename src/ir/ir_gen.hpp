@@ -24,7 +24,14 @@ class IRGenerator : public parser::ConstASTVisitor {
     };
 
    public:
+    // With optimize set, loops are rotated and their invariant expressions hoisted
+    // A library keeps every function so the host can call any of them, and its entry code only initializes the
+    // globals instead of also calling main
+    explicit IRGenerator(bool optimize = true, bool library = false) : m_optimize(optimize), m_library(library) {}
+
     ir::IRProgram generate(const parser::Program &ast);
+    // What sizeof(type) evaluates to
+    static uint32_t get_type_size(const parser::DataType &type);
 
     void visit(const parser::IntegerLiteral &node) override;
     void visit(const parser::FloatLiteral &node) override;
@@ -56,6 +63,8 @@ class IRGenerator : public parser::ConstASTVisitor {
 
    private:
     ir::IRProgram m_program;
+    bool m_optimize;
+    bool m_library;
     std::unordered_set<std::string> m_reachable;
 
     // Tracking for bytecode generation
@@ -98,8 +107,10 @@ class IRGenerator : public parser::ConstASTVisitor {
     void emit_push_str(uint32_t id);
     void emit_str_get();
     void emit_str_set();
+    void emit_load_byte();
     void emit_arr_alloc(uint32_t count, uint32_t elem_struct_slots);
     void emit_struct_alloc(uint32_t slots);
+    void emit_frame_alloc(uint16_t slot, uint32_t slots);
     void emit_load_var(uint16_t slot);
     void emit_store_var(uint16_t slot);
     void emit_load_global(uint16_t slot);
@@ -115,10 +126,14 @@ class IRGenerator : public parser::ConstASTVisitor {
     void emit_ret();
     void emit_halt();
     void emit_syscall(uint8_t args);
+    void emit_syscall_n(uint16_t index, uint8_t args);
     void emit_call(uint32_t addr, uint8_t args);
+    void emit_tail_call(uint32_t addr, uint8_t args);
     void emit_spawn(uint32_t addr, uint8_t args);
     void emit_load_ptr_offset(int32_t offset);
     void emit_store_ptr_offset(int32_t offset);
+    void emit_load_index(uint16_t elem_slots);
+    void emit_index_addr(uint16_t elem_slots);
     void emit_push_varargs();
     void emit_pop();
     void emit_yield();
@@ -134,11 +149,48 @@ class IRGenerator : public parser::ConstASTVisitor {
     void emit_gt_f();
     void emit_ge_f();
 
+    // Literals are interned as they are visited and laid out into the program's pool once generation is done; the
+    // views point at the map's keys, which stay put as it grows
+    std::unordered_map<std::string, uint32_t> m_string_ids;
+    std::vector<std::string_view> m_strings;
     uint32_t get_string_id(const std::string &str);
     Symbol get_var_symbol(const std::string &name);
-    uint32_t get_type_size(const parser::DataType &type);
     void visit(const parser::SizeofExpression &node) override;
     void define_var(const std::string &name);
+    // Evaluates an expression statement, dropping the value it leaves on the stack
+    void emit_discarded(const parser::Expression &expr);
+    uint16_t get_element_slots(const parser::DataType *object_type);
+
+    // Loop-invariant expressions of the enclosing loops, already evaluated into a slot before the loop was entered
+    std::unordered_map<const parser::Expression *, uint16_t> m_hoisted;
+    uint32_t m_hoisted_count = 0;
+    std::vector<const parser::Expression *> hoist_loop_invariants(const parser::ForStatement &node);
+    uint32_t m_loop_depth = 0;
+
+    // Inlining of small straight-line functions; the size budget is in AST nodes and grows with loop depth
+    static constexpr uint32_t InlineBaseBudget = 12;
+    struct InlineCandidate {
+        const parser::Function *func;
+        uint32_t cost;
+    };
+    std::unordered_map<std::string, InlineCandidate> m_inline_candidates;
+    std::unordered_set<std::string> m_inlining;
+    // Slots holding the variadic arguments of each function being inlined, innermost last
+    std::vector<std::vector<uint16_t>> m_inline_varargs;
+    bool m_in_variadic = false;
+    void collect_inline_candidates(const std::unordered_map<std::string, const parser::Function *> &funcs);
+    bool try_inline(const parser::FunctionCall &node);
+    // Returns whether the call was emitted as a TAIL_CALL, which leaves the frame and needs no RET after it
+    bool emit_function_call(const parser::FunctionCall &node, bool tail);
+    uint8_t call_arg_count(const std::vector<std::unique_ptr<parser::Expression>> &args, uint8_t slots);
+
+    // Uninitialized local structs and arrays that never escape their function live in its frame slots instead of
+    // the heap; they are capped so deep call chains stay within the stack's reserved capacity
+    static constexpr uint32_t FrameAllocMaxSlots = 256;
+    std::unordered_set<const parser::VariableDeclaration *> m_frame_allocated;
+    void analyze_escapes(const std::unordered_map<std::string, const parser::Function *> &funcs);
+    // Slots a declaration of `type` takes in the frame, or 0 when it has to be allocated on the heap
+    uint32_t get_frame_slots(const parser::DataType &type) const;
 
     struct JumpPlaceholder {
         size_t pos;
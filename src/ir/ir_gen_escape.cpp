@@ -0,0 +1,155 @@
+#include <string>
+#include <unordered_set>
+
+#include "ir/ir_gen.hpp"
+
+namespace ether::ir_gen {
+
+namespace {
+
+// Collects the names of a function body whose value may outlive the frame. A name only stays local while it is
+// used as the object of a member or index access, or handed to a parameter that does not escape either. Anything
+// else (returning it, storing it, spawning with it, passing it to a syscall or a variadic slot, reassigning it)
+// lets the handle leave the function.
+struct EscapeVisitor : parser::DefaultIgnoreConstASTVisitor {
+    const std::unordered_map<std::string, std::vector<bool>> &param_escapes;
+    std::unordered_set<std::string> escaped;
+    std::vector<const parser::VariableDeclaration *> decls;
+
+    explicit EscapeVisitor(const std::unordered_map<std::string, std::vector<bool>> &p) : param_escapes(p) {}
+
+    void place(const parser::Expression &object) {
+        if (!dynamic_cast<const parser::VariableExpression *>(&object)) object.accept(*this);
+    }
+    void assigned(const parser::Expression &lvalue) {
+        if (auto *var = dynamic_cast<const parser::VariableExpression *>(&lvalue)) {
+            escaped.insert(var->name);
+        } else {
+            lvalue.accept(*this);
+        }
+    }
+
+    void visit(const parser::VariableExpression &node) override { escaped.insert(node.name); }
+    void visit(const parser::FunctionCall &node) override {
+        std::vector<const parser::Expression *> actuals;
+        if (node.object) actuals.push_back(node.object.get());
+        for (const auto &arg : node.args) actuals.push_back(arg.get());
+
+        auto it = param_escapes.find(node.name);
+        for (size_t i = 0; i < actuals.size(); ++i) {
+            bool kept = it != param_escapes.end() && i < it->second.size() && !it->second[i];
+            if (kept && dynamic_cast<const parser::VariableExpression *>(actuals[i])) continue;
+            actuals[i]->accept(*this);
+        }
+    }
+    void visit(const parser::BinaryExpression &node) override {
+        node.left->accept(*this);
+        node.right->accept(*this);
+    }
+    void visit(const parser::Block &node) override {
+        for (const auto &stmt : node.statements) stmt->accept(*this);
+    }
+    void visit(const parser::IfStatement &node) override {
+        node.condition->accept(*this);
+        node.then_branch->accept(*this);
+        if (node.else_branch) node.else_branch->accept(*this);
+    }
+    void visit(const parser::ReturnStatement &node) override {
+        // A call in return position may become a TAIL_CALL, which reuses this frame for the callee
+        if (auto *call = dynamic_cast<const parser::FunctionCall *>(node.expr.get())) {
+            if (call->object) call->object->accept(*this);
+            for (const auto &arg : call->args) arg->accept(*this);
+        } else {
+            node.expr->accept(*this);
+        }
+    }
+    void visit(const parser::ExpressionStatement &node) override { node.expr->accept(*this); }
+    void visit(const parser::SpawnExpression &node) override {
+        // The new coroutine can outlive the spawning frame
+        if (node.call->object) node.call->object->accept(*this);
+        for (const auto &arg : node.call->args) arg->accept(*this);
+    }
+    void visit(const parser::AssignmentExpression &node) override {
+        assigned(*node.lvalue);
+        node.value->accept(*this);
+    }
+    void visit(const parser::IncrementExpression &node) override { assigned(*node.lvalue); }
+    void visit(const parser::DecrementExpression &node) override { assigned(*node.lvalue); }
+    void visit(const parser::AwaitExpression &node) override { node.expr->accept(*this); }
+    void visit(const parser::ForStatement &node) override {
+        if (node.init) node.init->accept(*this);
+        if (node.condition) node.condition->accept(*this);
+        if (node.increment) node.increment->accept(*this);
+        node.body->accept(*this);
+    }
+    void visit(const parser::VariableDeclaration &node) override {
+        decls.push_back(&node);
+        if (node.init) node.init->accept(*this);
+    }
+    void visit(const parser::MemberAccessExpression &node) override { place(*node.object); }
+    void visit(const parser::IndexExpression &node) override {
+        place(*node.object);
+        node.index->accept(*this);
+    }
+};
+
+}  // namespace
+
+uint32_t IRGenerator::get_frame_slots(const parser::DataType &type) const {
+    if (type.kind == parser::DataType::Kind::Struct) {
+        const auto &info = m_structs.at(type.struct_name);
+        // Nested struct members are separate heap objects, initialized through the handle
+        return info.struct_members.empty() ? info.total_size : 0;
+    }
+    if (type.kind == parser::DataType::Kind::Array && type.inner &&
+        type.inner->kind != parser::DataType::Kind::Struct) {
+        return type.array_size;
+    }
+    return 0;
+}
+
+void IRGenerator::analyze_escapes(const std::unordered_map<std::string, const parser::Function *> &funcs) {
+    m_frame_allocated.clear();
+    if (!m_optimize) return;
+
+    // Parameters start out as not escaping and are marked as uses are found, until nothing changes, so mutually
+    // recursive functions that only read through their parameters keep them local
+    std::unordered_map<std::string, std::vector<bool>> param_escapes;
+    for (const auto &[name, func] : funcs) {
+        if (m_reachable.contains(name)) param_escapes[name].assign(func->params.size(), false);
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto &[name, escapes] : param_escapes) {
+            const parser::Function &func = *funcs.at(name);
+            EscapeVisitor visitor(param_escapes);
+            func.body->accept(visitor);
+            std::vector<bool> result(func.params.size());
+            for (size_t i = 0; i < func.params.size(); ++i) {
+                result[i] = visitor.escaped.contains(func.params[i].name);
+            }
+            if (result != escapes) {
+                escapes = std::move(result);
+                changed = true;
+            }
+        }
+    }
+
+    for (const auto &[name, escapes] : param_escapes) {
+        const parser::Function &func = *funcs.at(name);
+        // The locals of a variadic function share slots with its variadic arguments
+        if (func.is_variadic) continue;
+        EscapeVisitor visitor(param_escapes);
+        func.body->accept(visitor);
+        for (const auto *decl : visitor.decls) {
+            uint32_t slots = get_frame_slots(decl->type);
+            if (decl->init || slots == 0 || slots > FrameAllocMaxSlots || visitor.escaped.contains(decl->name)) {
+                continue;
+            }
+            m_frame_allocated.insert(decl);
+        }
+    }
+}
+
+}  // namespace ether::ir_gen
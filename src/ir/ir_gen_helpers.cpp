@@ -39,11 +39,9 @@ void IRGenerator::emit_uint16(uint16_t val) {
 }
 
 uint32_t IRGenerator::get_string_id(const std::string &str) {
-    for (uint32_t i = 0; i < m_program.string_pool.size(); ++i) {
-        if (m_program.string_pool[i] == str) return i;
-    }
-    m_program.string_pool.push_back(str);
-    return (uint32_t)m_program.string_pool.size() - 1;
+    auto [it, inserted] = m_string_ids.try_emplace(str, (uint32_t)m_strings.size());
+    if (inserted) m_strings.push_back(it->first);
+    return it->second;
 }
 
 IRGenerator::Symbol IRGenerator::get_var_symbol(const std::string &name) {
@@ -61,6 +59,23 @@ void IRGenerator::define_var(const std::string &name) {
     scope.variables[name] = {slot, 1, scope.is_global};
 }
 
+void IRGenerator::emit_discarded(const parser::Expression &expr) {
+    expr.accept(*this);
+    // Assignments are the only expressions that leave nothing behind
+    if (!dynamic_cast<const parser::AssignmentExpression *>(&expr)) {
+        emit_pop();
+    }
+}
+
+uint16_t IRGenerator::get_element_slots(const parser::DataType *object_type) {
+    // Array elements are one slot each (structs are stored as handles); a struct pointer strides by the struct size
+    if (object_type && object_type->kind == parser::DataType::Kind::Ptr && object_type->inner &&
+        object_type->inner->kind == parser::DataType::Kind::Struct) {
+        return m_structs.at(object_type->inner->struct_name).total_size;
+    }
+    return 1;
+}
+
 IRGenerator::JumpPlaceholder IRGenerator::emit_jump(ir::OpCode op, uint32_t target) {
     emit_opcode(op);
     size_t pos = m_program.bytecode.size();
@@ -117,6 +132,8 @@ void IRGenerator::emit_str_get() { emit_opcode(ir::OpCode::STR_GET); }
 
 void IRGenerator::emit_str_set() { emit_opcode(ir::OpCode::STR_SET); }
 
+void IRGenerator::emit_load_byte() { emit_opcode(ir::OpCode::LOAD_BYTE); }
+
 void IRGenerator::emit_arr_alloc(uint32_t count, uint32_t elem_struct_slots) {
     emit_opcode(ir::OpCode::ARR_ALLOC);
     emit_uint32(count);
@@ -128,6 +145,12 @@ void IRGenerator::emit_struct_alloc(uint32_t slots) {
     emit_uint32(slots);
 }
 
+void IRGenerator::emit_frame_alloc(uint16_t slot, uint32_t slots) {
+    emit_opcode(ir::OpCode::FRAME_ALLOC);
+    emit_uint16(slot);
+    emit_uint32(slots);
+}
+
 void IRGenerator::emit_load_var(uint16_t slot) {
     emit_opcode(ir::OpCode::LOAD_VAR);
     emit_uint16(slot);
@@ -167,12 +190,24 @@ void IRGenerator::emit_syscall(uint8_t args) {
     emit_byte(args);
 }
 
+void IRGenerator::emit_syscall_n(uint16_t index, uint8_t args) {
+    emit_opcode(ir::OpCode::SYSCALL_N);
+    emit_uint16(index);
+    emit_byte(args);
+}
+
 void IRGenerator::emit_call(uint32_t addr, uint8_t args) {
     emit_opcode(ir::OpCode::CALL);
     emit_uint32(addr);
     emit_byte(args);
 }
 
+void IRGenerator::emit_tail_call(uint32_t addr, uint8_t args) {
+    emit_opcode(ir::OpCode::TAIL_CALL);
+    emit_uint32(addr);
+    emit_byte(args);
+}
+
 void IRGenerator::emit_spawn(uint32_t addr, uint8_t args) {
     emit_opcode(ir::OpCode::SPAWN);
     emit_uint32(addr);
@@ -189,6 +224,16 @@ void IRGenerator::emit_store_ptr_offset(int32_t offset) {
     emit_int32(offset);
 }
 
+void IRGenerator::emit_load_index(uint16_t elem_slots) {
+    emit_opcode(ir::OpCode::LOAD_INDEX);
+    emit_uint16(elem_slots);
+}
+
+void IRGenerator::emit_index_addr(uint16_t elem_slots) {
+    emit_opcode(ir::OpCode::INDEX_ADDR);
+    emit_uint16(elem_slots);
+}
+
 void IRGenerator::emit_push_varargs() { emit_opcode(ir::OpCode::PUSH_VARARGS); }
 void IRGenerator::emit_pop() { emit_opcode(ir::OpCode::POP); }
 void IRGenerator::emit_yield() { emit_opcode(ir::OpCode::YIELD); }
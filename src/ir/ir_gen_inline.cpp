@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <string>
+#include <unordered_set>
+
+#include "ir/ir_gen.hpp"
+
+namespace ether::ir_gen {
+
+namespace {
+
+// Measures a function body for inlining. Only straight-line bodies qualify: expression statements and local
+// declarations, optionally ending in a return, that name nothing but the function's own parameters and locals.
+struct InlineCostVisitor : parser::ConstASTVisitor {
+    std::unordered_set<std::string> names;
+    uint32_t cost = 0;
+    bool ok = true;
+
+    void visit(const parser::IntegerLiteral &) override { cost++; }
+    void visit(const parser::FloatLiteral &) override { cost++; }
+    void visit(const parser::StringLiteral &) override { cost++; }
+    void visit(const parser::VariableExpression &node) override {
+        cost++;
+        // Anything else would be looked up from the caller's scope
+        if (!names.contains(node.name)) ok = false;
+    }
+    void visit(const parser::FunctionCall &node) override {
+        cost++;
+        if (node.object) node.object->accept(*this);
+        for (const auto &arg : node.args) arg->accept(*this);
+    }
+    void visit(const parser::VarargExpression &) override { cost++; }
+    void visit(const parser::BinaryExpression &node) override {
+        cost++;
+        node.left->accept(*this);
+        node.right->accept(*this);
+    }
+    void visit(const parser::Block &) override { ok = false; }
+    void visit(const parser::IfStatement &) override { ok = false; }
+    void visit(const parser::ReturnStatement &node) override {
+        cost++;
+        node.expr->accept(*this);
+    }
+    void visit(const parser::ExpressionStatement &node) override { node.expr->accept(*this); }
+    void visit(const parser::YieldStatement &) override { cost++; }
+    void visit(const parser::SpawnExpression &node) override { node.call->accept(*this); }
+    void visit(const parser::AssignmentExpression &node) override {
+        cost++;
+        node.lvalue->accept(*this);
+        node.value->accept(*this);
+    }
+    void visit(const parser::IncrementExpression &node) override {
+        cost++;
+        node.lvalue->accept(*this);
+    }
+    void visit(const parser::DecrementExpression &node) override {
+        cost++;
+        node.lvalue->accept(*this);
+    }
+    void visit(const parser::AwaitExpression &node) override {
+        cost++;
+        node.expr->accept(*this);
+    }
+    void visit(const parser::ForStatement &) override { ok = false; }
+    void visit(const parser::VariableDeclaration &node) override {
+        cost++;
+        if (node.init) node.init->accept(*this);
+        names.insert(node.name);
+    }
+    void visit(const parser::Function &) override { ok = false; }
+    void visit(const parser::Include &) override { ok = false; }
+    void visit(const parser::StructDeclaration &) override { ok = false; }
+    void visit(const parser::EnumDeclaration &) override { ok = false; }
+    void visit(const parser::EnumAccessExpression &) override { cost++; }
+    void visit(const parser::MemberAccessExpression &node) override {
+        cost++;
+        node.object->accept(*this);
+    }
+    void visit(const parser::IndexExpression &node) override {
+        cost++;
+        node.object->accept(*this);
+        node.index->accept(*this);
+    }
+    void visit(const parser::SizeofExpression &) override { cost++; }
+    void visit(const parser::Program &) override { ok = false; }
+};
+
+}  // namespace
+
+void IRGenerator::collect_inline_candidates(const std::unordered_map<std::string, const parser::Function *> &funcs) {
+    m_inline_candidates.clear();
+    if (!m_optimize) return;
+    for (const auto &[name, func] : funcs) {
+        if (name == "main" || !m_reachable.contains(name)) continue;
+
+        InlineCostVisitor visitor;
+        for (const auto &param : func->params) visitor.names.insert(param.name);
+        const auto &statements = func->body->statements;
+        for (size_t i = 0; i < statements.size() && visitor.ok; ++i) {
+            // A return anywhere but at the end would need a jump out of the inlined body
+            if (dynamic_cast<const parser::ReturnStatement *>(statements[i].get()) && i + 1 != statements.size()) {
+                visitor.ok = false;
+                break;
+            }
+            statements[i]->accept(visitor);
+        }
+        if (visitor.ok) m_inline_candidates[name] = {func, visitor.cost};
+    }
+}
+
+bool IRGenerator::try_inline(const parser::FunctionCall &node) {
+    auto it = m_inline_candidates.find(node.name);
+    if (it == m_inline_candidates.end()) return false;
+    const parser::Function &func = *it->second.func;
+
+    // Larger bodies are still worth it inside loops, where the call overhead is paid on every iteration
+    uint32_t budget = InlineBaseBudget * (1 + std::min<uint32_t>(m_loop_depth, 3));
+    if (it->second.cost > budget || m_inlining.contains(node.name)) return false;
+    // Temporaries live in the caller's frame: global initializers have none, and in a variadic caller the locals
+    // share slots with the variadic arguments
+    if (m_scopes.size() < 2 || m_scopes.back().is_global || m_in_variadic) return false;
+
+    std::vector<const parser::Expression *> actuals;
+    if (node.object) actuals.push_back(node.object.get());
+    for (const auto &arg : node.args) {
+        if (dynamic_cast<const parser::VarargExpression *>(arg.get())) return false;
+        actuals.push_back(arg.get());
+    }
+    if (actuals.size() < func.params.size() || (!func.is_variadic && actuals.size() != func.params.size())) {
+        return false;
+    }
+
+    // Arguments are evaluated in call order into fresh slots, which then stand in for the parameters
+    Scope scope;
+    std::vector<uint16_t> varargs;
+    for (size_t i = 0; i < actuals.size(); ++i) {
+        actuals[i]->accept(*this);
+        uint16_t slot = m_scopes.back().next_slot++;
+        emit_store_var(slot);
+        if (i < func.params.size()) {
+            scope.variables[func.params[i].name] = {slot, 1, false};
+        } else {
+            varargs.push_back(slot);
+        }
+    }
+    scope.next_slot = m_scopes.back().next_slot;
+
+    m_scopes.push_back(std::move(scope));
+    m_inline_varargs.push_back(std::move(varargs));
+    m_inlining.insert(node.name);
+
+    bool returned = false;
+    for (const auto &stmt : func.body->statements) {
+        if (auto *ret = dynamic_cast<const parser::ReturnStatement *>(stmt.get())) {
+            ret->expr->accept(*this);
+            returned = true;
+        } else {
+            stmt->accept(*this);
+        }
+    }
+    if (!returned) emit_push_i32(0);
+
+    m_inlining.erase(node.name);
+    m_inline_varargs.pop_back();
+    uint16_t used = m_scopes.back().next_slot;
+    m_scopes.pop_back();
+    m_scopes.back().next_slot = std::max(m_scopes.back().next_slot, used);
+    return true;
+}
+
+}  // namespace ether::ir_gen
@@ -0,0 +1,259 @@
+#include <functional>
+#include <string>
+#include <unordered_set>
+
+#include "ir/ir_gen.hpp"
+
+namespace ether::ir_gen {
+
+namespace {
+
+// The variables a loop may write, and whether it may let other code run while it is in progress
+struct LoopEffects : parser::DefaultIgnoreConstASTVisitor {
+    std::unordered_set<std::string> written;
+    bool calls = false;
+
+    void mark(const parser::Expression &lvalue) {
+        if (auto *var = dynamic_cast<const parser::VariableExpression *>(&lvalue)) {
+            written.insert(var->name);
+        }
+    }
+
+    void visit(const parser::FunctionCall &node) override {
+        calls = true;
+        if (node.object) node.object->accept(*this);
+        for (const auto &arg : node.args) arg->accept(*this);
+    }
+    void visit(const parser::BinaryExpression &node) override {
+        node.left->accept(*this);
+        node.right->accept(*this);
+    }
+    void visit(const parser::Block &node) override {
+        for (const auto &stmt : node.statements) stmt->accept(*this);
+    }
+    void visit(const parser::IfStatement &node) override {
+        node.condition->accept(*this);
+        node.then_branch->accept(*this);
+        if (node.else_branch) node.else_branch->accept(*this);
+    }
+    void visit(const parser::ReturnStatement &node) override { node.expr->accept(*this); }
+    void visit(const parser::ExpressionStatement &node) override { node.expr->accept(*this); }
+    void visit(const parser::YieldStatement &node) override { calls = true; }
+    void visit(const parser::SpawnExpression &node) override { node.call->accept(*this); }
+    void visit(const parser::AssignmentExpression &node) override {
+        mark(*node.lvalue);
+        node.lvalue->accept(*this);
+        node.value->accept(*this);
+    }
+    void visit(const parser::IncrementExpression &node) override {
+        mark(*node.lvalue);
+        node.lvalue->accept(*this);
+    }
+    void visit(const parser::DecrementExpression &node) override {
+        mark(*node.lvalue);
+        node.lvalue->accept(*this);
+    }
+    void visit(const parser::AwaitExpression &node) override {
+        calls = true;
+        node.expr->accept(*this);
+    }
+    void visit(const parser::ForStatement &node) override {
+        if (node.init) node.init->accept(*this);
+        if (node.condition) node.condition->accept(*this);
+        if (node.increment) node.increment->accept(*this);
+        node.body->accept(*this);
+    }
+    void visit(const parser::VariableDeclaration &node) override {
+        written.insert(node.name);
+        if (node.init) node.init->accept(*this);
+    }
+    void visit(const parser::MemberAccessExpression &node) override { node.object->accept(*this); }
+    void visit(const parser::IndexExpression &node) override {
+        node.object->accept(*this);
+        node.index->accept(*this);
+    }
+};
+
+// Finds the outermost expressions of a loop that are worth computing once before it: arithmetic and comparisons
+// over values the loop never changes, and global loads. Only operations that cannot fail are picked, since the
+// hoisted code also runs when the loop body does not.
+struct InvariantCollector : parser::DefaultIgnoreConstASTVisitor {
+    const LoopEffects &effects;
+    const std::unordered_map<const parser::Expression *, uint16_t> &hoisted;
+    std::function<bool(const std::string &)> is_global;
+    std::vector<const parser::Expression *> found;
+
+    InvariantCollector(const LoopEffects &e, const std::unordered_map<const parser::Expression *, uint16_t> &h,
+                       std::function<bool(const std::string &)> g)
+        : effects(e), hoisted(h), is_global(std::move(g)) {}
+
+    static bool is_text(const parser::Expression &expr) {
+        return !expr.type || expr.type->kind == parser::DataType::Kind::String ||
+               expr.type->kind == parser::DataType::Kind::Bytes;
+    }
+
+    bool is_invariant(const parser::Expression &expr) const {
+        if (dynamic_cast<const parser::IntegerLiteral *>(&expr) || dynamic_cast<const parser::FloatLiteral *>(&expr) ||
+            dynamic_cast<const parser::EnumAccessExpression *>(&expr) ||
+            dynamic_cast<const parser::SizeofExpression *>(&expr)) {
+            return true;
+        }
+        if (auto *var = dynamic_cast<const parser::VariableExpression *>(&expr)) {
+            if (effects.written.contains(var->name)) return false;
+            // Another coroutine or a callee may store to a global while the loop runs
+            return !effects.calls || !is_global(var->name);
+        }
+        if (auto *bin = dynamic_cast<const parser::BinaryExpression *>(&expr)) {
+            // String concatenation allocates, and integer division traps on zero
+            if (is_text(*bin->left) || is_text(*bin->right)) return false;
+            if (bin->op == parser::BinaryExpression::Op::Div && !bin->left->type->is_float()) return false;
+            return is_invariant(*bin->left) && is_invariant(*bin->right);
+        }
+        return false;
+    }
+
+    void consider(const parser::Expression &expr) {
+        if (hoisted.contains(&expr)) return;
+        auto *var = dynamic_cast<const parser::VariableExpression *>(&expr);
+        bool worth = dynamic_cast<const parser::BinaryExpression *>(&expr) || var;
+        if (worth && is_invariant(expr) && (!var || is_global(var->name))) {
+            found.push_back(&expr);
+            return;
+        }
+        expr.accept(*this);
+    }
+
+    // Member and index objects are resolved in place by the lvalue resolver, so only their indices can be hoisted
+    void consider_place(const parser::Expression &expr) {
+        if (auto *idx = dynamic_cast<const parser::IndexExpression *>(&expr)) {
+            consider_place(*idx->object);
+            consider(*idx->index);
+        } else if (auto *member = dynamic_cast<const parser::MemberAccessExpression *>(&expr)) {
+            consider_place(*member->object);
+        }
+    }
+
+    void visit(const parser::FunctionCall &node) override {
+        for (const auto &arg : node.args) consider(*arg);
+    }
+    void visit(const parser::BinaryExpression &node) override {
+        consider(*node.left);
+        consider(*node.right);
+    }
+    void visit(const parser::Block &node) override {
+        for (const auto &stmt : node.statements) stmt->accept(*this);
+    }
+    void visit(const parser::IfStatement &node) override {
+        consider(*node.condition);
+        node.then_branch->accept(*this);
+        if (node.else_branch) node.else_branch->accept(*this);
+    }
+    void visit(const parser::ReturnStatement &node) override { consider(*node.expr); }
+    void visit(const parser::ExpressionStatement &node) override { consider(*node.expr); }
+    void visit(const parser::SpawnExpression &node) override { visit(*node.call); }
+    void visit(const parser::AssignmentExpression &node) override {
+        consider_place(*node.lvalue);
+        consider(*node.value);
+    }
+    void visit(const parser::IncrementExpression &node) override { consider_place(*node.lvalue); }
+    void visit(const parser::DecrementExpression &node) override { consider_place(*node.lvalue); }
+    void visit(const parser::AwaitExpression &node) override { consider(*node.expr); }
+    void visit(const parser::ForStatement &node) override {
+        if (node.init) node.init->accept(*this);
+        if (node.condition) consider(*node.condition);
+        if (node.increment) consider(*node.increment);
+        node.body->accept(*this);
+    }
+    void visit(const parser::VariableDeclaration &node) override {
+        if (node.init) consider(*node.init);
+    }
+    void visit(const parser::MemberAccessExpression &node) override { consider_place(node); }
+    void visit(const parser::IndexExpression &node) override { consider_place(node); }
+};
+
+}  // namespace
+
+std::vector<const parser::Expression *> IRGenerator::hoist_loop_invariants(const parser::ForStatement &node) {
+    LoopEffects effects;
+    if (node.condition) node.condition->accept(effects);
+    if (node.increment) node.increment->accept(effects);
+    node.body->accept(effects);
+
+    InvariantCollector collector(effects, m_hoisted,
+                                 [this](const std::string &name) { return get_var_symbol(name).is_global; });
+    if (node.condition) collector.consider(*node.condition);
+    if (node.increment) collector.consider(*node.increment);
+    node.body->accept(collector);
+
+    for (const auto *expr : collector.found) {
+        // '$' cannot start an identifier, so the temporary never collides with a user variable
+        std::string name = "$inv" + std::to_string(m_hoisted_count++);
+        define_var(name);
+        uint16_t slot = get_var_symbol(name).slot;
+        expr->accept(*this);
+        emit_store_var(slot);
+        m_hoisted[expr] = slot;
+    }
+    return collector.found;
+}
+
+void IRGenerator::visit(const parser::ForStatement &node) {
+    if (node.init) node.init->accept(*this);
+    m_loop_depth++;
+
+    if (!m_optimize) {
+        size_t start_label = m_program.bytecode.size();
+        JumpPlaceholder jump_to_exit{0};
+
+        if (node.condition) {
+            node.condition->accept(*this);
+            jump_to_exit = emit_jump(ir::OpCode::JZ);
+        }
+
+        node.body->accept(*this);
+
+        if (node.increment) {
+            emit_discarded(*node.increment);
+        }
+
+        emit_jump(ir::OpCode::JMP, (uint32_t)start_label);
+
+        if (node.condition) {
+            patch_jump(jump_to_exit, m_program.bytecode.size());
+        }
+        m_loop_depth--;
+        return;
+    }
+
+    auto hoisted = hoist_loop_invariants(node);
+
+    // Rotated loop: the condition is tested once on entry, then at the bottom of every iteration, so each
+    // iteration takes a single branch
+    JumpPlaceholder jump_to_exit{0};
+    if (node.condition) {
+        node.condition->accept(*this);
+        jump_to_exit = emit_jump(ir::OpCode::JZ);
+    }
+
+    size_t body_label = m_program.bytecode.size();
+    node.body->accept(*this);
+
+    if (node.increment) {
+        emit_discarded(*node.increment);
+    }
+
+    if (node.condition) {
+        node.condition->accept(*this);
+        emit_jump(ir::OpCode::JNZ, (uint32_t)body_label);
+        patch_jump(jump_to_exit, m_program.bytecode.size());
+    } else {
+        emit_jump(ir::OpCode::JMP, (uint32_t)body_label);
+    }
+
+    for (const auto *expr : hoisted) {
+        m_hoisted.erase(expr);
+    }
+    m_loop_depth--;
+}
+
+}  // namespace ether::ir_gen
@@ -67,26 +67,7 @@ void IRGenerator::LValueResolver::visit(const parser::IndexExpression &idx) {
     // Now compute index offset
     idx.index->accept(*gen);
 
-    // Multiply by element size if needed
-    uint16_t element_size = 1;
-    if (idx.object->type) {
-        if (idx.object->type->kind == parser::DataType::Kind::Ptr && idx.object->type->inner) {
-            if (idx.object->type->inner->kind == parser::DataType::Kind::Struct) {
-                element_size = gen->m_structs.at(idx.object->type->inner->struct_name).total_size;
-            }
-        } else if (idx.object->type->kind == parser::DataType::Kind::Array && idx.object->type->inner) {
-            if (idx.object->type->inner->kind == parser::DataType::Kind::Struct) {
-                element_size = 1;
-            }
-        }
-    }
-
-    // Multiply by 16 to convert slot offset to byte offset
-    gen->emit_push_i32(16 * element_size);  // sizeof(Value)
-    gen->emit_mul();
-
-    // Add to get final address
-    gen->emit_add();
+    gen->emit_index_addr(gen->get_element_slots(idx.object->type.get()));
 
     // Now we're in Heap mode with computed address on stack
     kind = Heap;
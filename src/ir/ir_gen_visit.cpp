@@ -38,43 +38,21 @@ void IRGenerator::visit(const parser::IndexExpression &node) {
         return;
     }
 
-    // Load pointer
-    node.object->accept(*this);
-
-    // Load index
-    node.index->accept(*this);
-
-    // The pointer is now at stack[-2] and index at stack[-1]
-    // We need to compute: ptr + (index * element_size)
-    // For now, we assume element size is 16 bytes (1 slot)
-    // If the inner type is a struct, we need to multiply by its size
-
-    uint16_t element_size = 1;
-    if (node.object->type) {
-        if (node.object->type->kind == parser::DataType::Kind::Ptr && node.object->type->inner) {
-            if (node.object->type->inner->kind == parser::DataType::Kind::Struct) {
-                element_size = m_structs.at(node.object->type->inner->struct_name).total_size;
-            }
-        } else if (node.object->type->kind == parser::DataType::Kind::Array && node.object->type->inner) {
-            if (node.object->type->inner->kind == parser::DataType::Kind::Struct) {
-                element_size = 1;
-            }
-        }
+    if (node.object->type && node.object->type->kind == parser::DataType::Kind::Bytes) {
+        node.object->accept(*this);
+        node.index->accept(*this);
+        emit_load_byte();
+        return;
     }
 
-    // Multiply by 16 to convert slot offset to byte offset
-    emit_push_i32(16 * element_size);  // sizeof(Value)
-    emit_mul();
-
-    // Add byte offset to pointer
-    emit_add();
-
-    // Load from the computed address (offset 0)
-    emit_load_ptr_offset(0);
+    node.object->accept(*this);
+    node.index->accept(*this);
+    emit_load_index(get_element_slots(node.object->type.get()));
 }
 
 void IRGenerator::visit(const parser::Function &func) {
     m_scopes.emplace_back();  // New scope for function
+    m_in_variadic = func.is_variadic;
 
     // Define parameters in scope
     for (const auto &param : func.params) {
@@ -135,13 +113,29 @@ void IRGenerator::visit(const parser::Block &block) {
 }
 
 void IRGenerator::visit(const parser::ReturnStatement &node) {
-    node.expr->accept(*this);
+    // `return f(...)` hands the frame over to the callee, so tail recursion runs in constant stack space
+    auto *call = dynamic_cast<const parser::FunctionCall *>(node.expr.get());
+    if (call && m_optimize) {
+        if (emit_function_call(*call, true)) return;
+    } else {
+        node.expr->accept(*this);
+    }
     emit_ret();
 }
 
 void IRGenerator::visit(const parser::VariableDeclaration &node) {
     define_var(node.name);
 
+    if (m_frame_allocated.contains(&node) && !m_scopes.back().is_global && !m_in_variadic) {
+        // The aggregate never outlives the frame, so its fields take the slots right after the variable itself
+        uint32_t slots = get_frame_slots(node.type);
+        uint16_t data = m_scopes.back().next_slot;
+        m_scopes.back().next_slot += slots;
+        emit_frame_alloc(data, slots);
+        emit_store_var(get_var_symbol(node.name).slot);
+        return;
+    }
+
     if (node.init) {
         node.init->accept(*this);
     } else if (node.type.kind == parser::DataType::Kind::Array) {
@@ -208,25 +202,20 @@ void IRGenerator::visit(const parser::VariableDeclaration &node) {
             emit_struct_alloc(elem_info.total_size);
             emit_load_symbol(s);
             emit_push_i32((int32_t)i);
-            emit_push_i32(16);  // sizeof(Value) * element_size(1)
-            emit_mul();
-            emit_add();
+            emit_index_addr(1);
             emit_store_ptr_offset(0);
 
             auto emit_load_elem = [&]() {
                 emit_load_symbol(s);
                 emit_push_i32((int32_t)i);
-                emit_push_i32(16);
-                emit_mul();
-                emit_add();
-                emit_load_ptr_offset(0);
+                emit_load_index(1);
             };
             emit_init_struct(node.type.inner->struct_name, emit_load_elem);
         }
     }
 }
 
-void IRGenerator::visit(const parser::ExpressionStatement &node) { node.expr->accept(*this); }
+void IRGenerator::visit(const parser::ExpressionStatement &node) { emit_discarded(*node.expr); }
 
 void IRGenerator::visit(const parser::IfStatement &node) {
     node.condition->accept(*this);
@@ -242,30 +231,6 @@ void IRGenerator::visit(const parser::IfStatement &node) {
     patch_jump(jump_to_end, m_program.bytecode.size());
 }
 
-void IRGenerator::visit(const parser::ForStatement &node) {
-    if (node.init) node.init->accept(*this);
-
-    size_t start_label = m_program.bytecode.size();
-    JumpPlaceholder jump_to_exit{0};
-
-    if (node.condition) {
-        node.condition->accept(*this);
-        jump_to_exit = emit_jump(ir::OpCode::JZ);
-    }
-
-    node.body->accept(*this);
-
-    if (node.increment) {
-        node.increment->accept(*this);
-    }
-
-    emit_jump(ir::OpCode::JMP, (uint32_t)start_label);
-
-    if (node.condition) {
-        patch_jump(jump_to_exit, m_program.bytecode.size());
-    }
-}
-
 void IRGenerator::visit(const parser::YieldStatement &node) { emit_yield(); }
 
 void IRGenerator::visit(const parser::IntegerLiteral &node) {
@@ -289,6 +254,11 @@ void IRGenerator::visit(const parser::FloatLiteral &node) {
 }
 
 void IRGenerator::visit(const parser::VariableExpression &node) {
+    if (auto it = m_hoisted.find(&node); it != m_hoisted.end()) {
+        emit_load_var(it->second);
+        return;
+    }
+
     Symbol s = get_var_symbol(node.name);
 
     if (s.is_global) {
@@ -312,15 +282,7 @@ void IRGenerator::visit(const parser::AssignmentExpression &node) {
         idx_expr->object->accept(*this);
 
         idx_expr->index->accept(*this);
-
-        uint16_t element_size = 1;
-        if (idx_expr->object->type->inner && idx_expr->object->type->inner->kind == parser::DataType::Kind::Struct) {
-            element_size = m_structs.at(idx_expr->object->type->inner->struct_name).total_size;
-        }
-
-        emit_push_i32(16 * element_size);
-        emit_mul();
-        emit_add();
+        emit_index_addr(get_element_slots(idx_expr->object->type.get()));
 
         emit_store_ptr_offset(0);
     } else {
@@ -400,13 +362,10 @@ void IRGenerator::visit(const parser::SpawnExpression &node) {
         arg->accept(*this);
     }
 
-    uint8_t num_args = (uint8_t)node.call->args.size();
-    if (!node.call->args.empty() && dynamic_cast<const parser::VarargExpression *>(node.call->args.back().get())) {
-        num_args |= 0x80;
-    }
+    uint8_t num_args = call_arg_count(node.call->args, (uint8_t)node.call->args.size());
 
     if (node.call->name == "syscall") {
-        emit_spawn(0xFFFFFFFF, num_args);
+        emit_spawn(ir::IRProgram::NativeCall, num_args);
     } else {
         size_t patch_pos = m_program.bytecode.size() + 1;
         m_call_patches.push_back({patch_pos, node.call->name});
@@ -415,6 +374,11 @@ void IRGenerator::visit(const parser::SpawnExpression &node) {
 }
 
 void IRGenerator::visit(const parser::BinaryExpression &node) {
+    if (auto it = m_hoisted.find(&node); it != m_hoisted.end()) {
+        emit_load_var(it->second);
+        return;
+    }
+
     node.left->accept(*this);
     node.right->accept(*this);
 
@@ -485,7 +449,11 @@ void IRGenerator::visit(const parser::BinaryExpression &node) {
 
 void IRGenerator::visit(const parser::StringLiteral &node) { emit_push_str(get_string_id(node.value)); }
 
-void IRGenerator::visit(const parser::FunctionCall &node) {
+void IRGenerator::visit(const parser::FunctionCall &node) { emit_function_call(node, false); }
+
+bool IRGenerator::emit_function_call(const parser::FunctionCall &node, bool tail) {
+    if (m_optimize && try_inline(node)) return false;
+
     uint8_t total_slots = 0;
 
     // If this is a method call, push 'this' pointer first
@@ -506,7 +474,10 @@ void IRGenerator::visit(const parser::FunctionCall &node) {
         }
     }
 
+    // A checked built-in syscall goes straight to its handler, so its constant id is never pushed
+    bool known_syscall = m_optimize && node.syscall_index >= 0;
     for (const auto &arg : node.args) {
+        if (known_syscall && &arg == &node.args.front()) continue;
         arg->accept(*this);
         // Calculate size of argument
         uint8_t size = 1;
@@ -517,20 +488,41 @@ void IRGenerator::visit(const parser::FunctionCall &node) {
     }
 
     // We pass total_slots as the number of args passed
-    uint8_t num_args = total_slots;
-
-    if (!node.args.empty() && dynamic_cast<const parser::VarargExpression *>(node.args.back().get())) {
-        num_args |= 0x80;
+    uint8_t num_args = call_arg_count(node.args, total_slots);
+    if (known_syscall) {
+        emit_syscall_n((uint16_t)node.syscall_index, num_args);
+        return false;
     }
     if (node.name == "syscall") {
         emit_syscall(num_args);
+        return false;
+    }
+    size_t patch_pos = m_program.bytecode.size() + 1;
+    m_call_patches.push_back({patch_pos, node.name});
+    if (tail) {
+        emit_tail_call(0, num_args);
     } else {
-        size_t patch_pos = m_program.bytecode.size() + 1;
-        m_call_patches.push_back({patch_pos, node.name});
         emit_call(0, num_args);
     }
+    return tail;
 }
 
-void IRGenerator::visit(const parser::VarargExpression &node) { emit_push_varargs(); }
+void IRGenerator::visit(const parser::VarargExpression &node) {
+    if (m_inline_varargs.empty()) {
+        emit_push_varargs();
+        return;
+    }
+    // Forwarding from an inlined variadic function: its extra arguments are in known slots
+    for (uint16_t slot : m_inline_varargs.back()) {
+        emit_load_var(slot);
+    }
+}
+
+uint8_t IRGenerator::call_arg_count(const std::vector<std::unique_ptr<parser::Expression>> &args, uint8_t slots) {
+    if (args.empty() || !dynamic_cast<const parser::VarargExpression *>(args.back().get())) return slots;
+    if (m_inline_varargs.empty()) return slots | 0x80;
+    // The `...` slot is replaced by the forwarded arguments themselves
+    return (uint8_t)(slots - 1 + m_inline_varargs.back().size());
+}
 
 }  // namespace ether::ir_gen
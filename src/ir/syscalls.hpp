@@ -0,0 +1,66 @@
+#ifndef ETHER_IR_SYSCALLS_HPP
+#define ETHER_IR_SYSCALLS_HPP
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace ether::ir {
+
+// What a syscall accepts in one argument position
+enum class SyscallArg : uint8_t {
+    Any,
+    Int,     // Any integer type, including enum members
+    String,  // string
+    Bytes,   // bytes
+    Text,    // string or bytes
+    Buffer,  // string, ptr or array: memory the kernel reads from
+};
+
+// The signature of a built-in syscall, checked by the analyzer when the id is a constant and by the VM otherwise.
+// SYSCALL_N refers to a syscall by its index in Syscalls, which the VM's handler table follows.
+struct SyscallSignature {
+    int64_t id;
+    std::string_view name;
+    uint8_t min_args;  // Not counting the id
+    uint8_t max_args;  // VariadicArgs when any number may follow
+    std::array<SyscallArg, 5> args;
+
+    static constexpr uint8_t VariadicArgs = 0xFF;
+    SyscallArg arg(size_t i) const { return i < args.size() ? args[i] : SyscallArg::Any; }
+};
+
+inline constexpr auto Syscalls = [] {
+    using enum SyscallArg;
+    return std::array<SyscallSignature, 17>{{
+        {0, "open", 4, 4, {Int, String, Int, Int}},
+        {1, "read", 3, 4, {Int, Any, Int, Int}},
+        {2, "write", 3, 4, {Int, Buffer, Int, Int}},
+        {3, "close", 1, 1, {Int}},
+        {4, "sleep", 1, 1, {Int}},
+        {5, "accept", 1, 2, {Int, Int}},
+        {6, "connect", 3, 4, {Int, String, Int, Int}},
+        {7, "send", 4, 4, {Int, Buffer, Int, Int}},
+        {8, "recv", 4, 5, {Int, Any, Int, Int, Int}},
+        {10, "printf", 1, SyscallSignature::VariadicArgs, {String}},
+        {13, "socket", 3, 3, {Int, Int, Int}},
+        {14, "bind", 2, 3, {Int, Any, Int}},  // bind(fd, port) or bind(fd, address, port)
+        {15, "listen", 2, 2, {Int, Int}},
+        {16, "strlen", 1, 1, {Text}},
+        {17, "mmap", 2, 2, {String, Int}},
+        {18, "munmap", 1, 1, {Bytes}},
+        {19, "madvise", 2, 2, {Bytes, Int}},
+    }};
+}();
+
+// Index of the syscall with `id` in Syscalls, or -1 when it is not a built-in one
+constexpr int find_syscall(int64_t id) {
+    for (size_t i = 0; i < Syscalls.size(); ++i) {
+        if (Syscalls[i].id == id) return (int)i;
+    }
+    return -1;
+}
+
+}  // namespace ether::ir
+
+#endif  // ETHER_IR_SYSCALLS_HPP
@@ -0,0 +1,110 @@
+#ifndef ETHER_LEXER_KEYWORDS_HPP
+#define ETHER_LEXER_KEYWORDS_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "token.hpp"
+
+namespace ether::lexer {
+
+struct Keyword {
+    std::string_view text;
+    TokenType type;
+};
+
+// Every keyword of the language. The lexer recognizes them through keyword_type() and the language server colors
+// them from the same table.
+inline constexpr Keyword Keywords[] = {
+    {"i64", TokenType::I64},       {"i32", TokenType::I32},
+    {"i16", TokenType::I16},       {"i8", TokenType::I8},
+    {"f64", TokenType::F64},       {"f32", TokenType::F32},
+    {"return", TokenType::Return}, {"if", TokenType::If},
+    {"else", TokenType::Else},     {"while", TokenType::While},
+    {"for", TokenType::For},       {"string", TokenType::String},
+    {"spawn", TokenType::Spawn},   {"yield", TokenType::Yield},
+    {"await", TokenType::Await},   {"coroutine", TokenType::Coroutine},
+    {"ptr", TokenType::Ptr},       {"void", TokenType::Void},
+    {"struct", TokenType::Struct}, {"enum", TokenType::Enum},
+    {"sizeof", TokenType::Sizeof}, {"bytes", TokenType::Bytes}};
+
+namespace detail {
+
+// A perfect hash of the keywords: (size * a + first * b + last * c) % KeywordSlots gives each keyword a slot of its
+// own, so a word is a keyword exactly when it equals the one in its slot. The multipliers are searched for at compile
+// time; when a new keyword makes the search fail, try another slot count.
+inline constexpr size_t KeywordSlots = 61;
+
+struct KeywordHash {
+    uint32_t a = 0, b = 0, c = 0;
+
+    constexpr size_t operator()(std::string_view text) const {
+        return (text.size() * a + (unsigned char)text.front() * b + (unsigned char)text.back() * c) % KeywordSlots;
+    }
+};
+
+inline constexpr KeywordHash FoundKeywordHash = [] {
+    for (uint32_t a = 1; a < KeywordSlots; ++a) {
+        for (uint32_t b = 1; b < KeywordSlots; ++b) {
+            for (uint32_t c = 1; c < KeywordSlots; ++c) {
+                KeywordHash hash{a, b, c};
+                std::array<bool, KeywordSlots> used{};
+                bool perfect = true;
+                for (const auto &keyword : Keywords) {
+                    size_t slot = hash(keyword.text);
+                    if (used[slot]) {
+                        perfect = false;
+                        break;
+                    }
+                    used[slot] = true;
+                }
+                if (perfect) return hash;
+            }
+        }
+    }
+    return KeywordHash{};
+}();
+static_assert(FoundKeywordHash.a != 0, "No perfect hash of the keywords fits in KeywordSlots");
+
+// Index into Keywords of the keyword in each slot, or -1
+inline constexpr auto KeywordTable = [] {
+    std::array<int8_t, KeywordSlots> table{};
+    table.fill(-1);
+    for (size_t i = 0; i < std::size(Keywords); ++i) table[FoundKeywordHash(Keywords[i].text)] = (int8_t)i;
+    return table;
+}();
+
+inline constexpr size_t MaxKeywordLength = [] {
+    size_t longest = 0;
+    for (const auto &keyword : Keywords) longest = std::max(longest, keyword.text.size());
+    return longest;
+}();
+
+}  // namespace detail
+
+// The keyword `text` spells, or TokenType::Identifier when it is none
+constexpr TokenType keyword_type(std::string_view text) {
+    if (text.empty() || text.size() > detail::MaxKeywordLength) return TokenType::Identifier;
+    int8_t index = detail::KeywordTable[detail::FoundKeywordHash(text)];
+    if (index < 0 || Keywords[index].text != text) return TokenType::Identifier;
+    return Keywords[index].type;
+}
+
+constexpr bool is_keyword(TokenType type) {
+    for (const auto &keyword : Keywords) {
+        if (keyword.type == type) return true;
+    }
+    return false;
+}
+
+static_assert(keyword_type("coroutine") == TokenType::Coroutine);
+static_assert(keyword_type("i8") == TokenType::I8);
+static_assert(keyword_type("whale") == TokenType::Identifier);
+static_assert(keyword_type("i9") == TokenType::Identifier);
+
+}  // namespace ether::lexer
+
+#endif  // ETHER_LEXER_KEYWORDS_HPP
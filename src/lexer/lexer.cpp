@@ -1,27 +1,149 @@
 #define ETHER_LEXER_CPP
 #include "lexer.hpp"
 
+#include <algorithm>
+#include <bit>
 #include <cctype>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 #include "common/error.hpp"
+#include "keywords.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace ether::lexer {
 
-static const std::unordered_map<std::string_view, TokenType> keywords = {
-    {"i64", TokenType::I64},       {"i32", TokenType::I32},
-    {"i16", TokenType::I16},       {"i8", TokenType::I8},
-    {"f64", TokenType::F64},       {"f32", TokenType::F32},
-    {"return", TokenType::Return}, {"if", TokenType::If},
-    {"else", TokenType::Else},     {"while", TokenType::While},
-    {"for", TokenType::For},       {"string", TokenType::String},
-    {"spawn", TokenType::Spawn},   {"yield", TokenType::Yield},
-    {"await", TokenType::Await},   {"coroutine", TokenType::Coroutine},
-    {"ptr", TokenType::Ptr},       {"void", TokenType::Void},
-    {"struct", TokenType::Struct}, {"enum", TokenType::Enum},
-    {"sizeof", TokenType::Sizeof}};
+std::string unescape(std::string_view text) {
+    std::string value;
+    value.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] != '\\' || i + 1 == text.size()) {
+            value += text[i];
+            continue;
+        }
+        switch (char escaped = text[++i]) {
+            case 'n':
+                value += '\n';
+                break;
+            case 't':
+                value += '\t';
+                break;
+            case 'r':
+                value += '\r';
+                break;
+            default:
+                value += escaped;
+                break;
+        }
+    }
+    return value;
+}
+
+int64_t integer_value(std::string_view lexeme) {
+    if (lexeme.starts_with('\'')) return (int)unescape(lexeme.substr(1, lexeme.size() - 2))[0];
+    return std::stoll(std::string(lexeme));
+}
+
+// Scanners for the long runs the lexer skips over: whitespace, comments, identifiers and literal bodies. Each returns
+// the first character in [p, end) that ends the run. With SSE2, which every x86-64 CPU has, they test 16 characters
+// per step and finish the last few one at a time.
+namespace {
+
+bool is_space(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+bool is_ident(char c) {
+    char lower = (char)(c | 0x20);
+    return (lower >= 'a' && lower <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+#if defined(__SSE2__)
+constexpr ptrdiff_t BlockSize = 16;
+
+__m128i load(const char *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+__m128i equal(__m128i block, char c) { return _mm_cmpeq_epi8(block, _mm_set1_epi8(c)); }
+// Signed compares: bytes of 0x80 and up are negative, so they are never in an ASCII range
+__m128i in_range(__m128i block, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8((char)(lo - 1))),
+                         _mm_cmplt_epi8(block, _mm_set1_epi8((char)(hi + 1))));
+}
+unsigned mask_of(__m128i matches) { return (unsigned)_mm_movemask_epi8(matches); }
+#endif
+
+const char *skip_spaces(const char *p, const char *end) {
+#if defined(__SSE2__)
+    for (; end - p >= BlockSize; p += BlockSize) {
+        __m128i block = load(p);
+        unsigned spaces = mask_of(_mm_or_si128(equal(block, ' '), in_range(block, '\t', '\r')));
+        if (spaces != 0xFFFF) return p + std::countr_one(spaces);
+    }
+#endif
+    while (p < end && is_space(*p)) ++p;
+    return p;
+}
+
+const char *skip_identifier(const char *p, const char *end) {
+#if defined(__SSE2__)
+    for (; end - p >= BlockSize; p += BlockSize) {
+        __m128i block = load(p);
+        __m128i letters = in_range(_mm_or_si128(block, _mm_set1_epi8(0x20)), 'a', 'z');
+        unsigned ident = mask_of(_mm_or_si128(_mm_or_si128(letters, in_range(block, '0', '9')), equal(block, '_')));
+        if (ident != 0xFFFF) return p + std::countr_one(ident);
+    }
+#endif
+    while (p < end && is_ident(*p)) ++p;
+    return p;
+}
+
+// The end of a line comment: the newline, or a NUL, which ends the source as far as the lexer is concerned
+const char *find_line_end(const char *p, const char *end) {
+#if defined(__SSE2__)
+    for (; end - p >= BlockSize; p += BlockSize) {
+        __m128i block = load(p);
+        if (unsigned stop = mask_of(_mm_or_si128(equal(block, '\n'), equal(block, '\0')))) {
+            return p + std::countr_zero(stop);
+        }
+    }
+#endif
+    while (p < end && *p != '\n' && *p != '\0') ++p;
+    return p;
+}
+
+// The closing quote of a string or char literal, or the next escape sequence or NUL in it
+const char *find_literal_stop(const char *p, const char *end, char quote) {
+#if defined(__SSE2__)
+    for (; end - p >= BlockSize; p += BlockSize) {
+        __m128i block = load(p);
+        __m128i stops = _mm_or_si128(_mm_or_si128(equal(block, quote), equal(block, '\\')), equal(block, '\0'));
+        if (unsigned stop = mask_of(stops)) return p + std::countr_zero(stop);
+    }
+#endif
+    while (p < end && *p != quote && *p != '\\' && *p != '\0') ++p;
+    return p;
+}
+
+// Number of newlines in [p, end); `last` is left at the last one, if any
+int count_newlines(const char *p, const char *end, const char *&last) {
+    int count = 0;
+#if defined(__SSE2__)
+    for (; end - p >= BlockSize; p += BlockSize) {
+        if (unsigned newlines = mask_of(equal(load(p), '\n'))) {
+            count += std::popcount(newlines);
+            last = p + (31 - std::countl_zero(newlines));
+        }
+    }
+#endif
+    for (; p < end; ++p) {
+        if (*p == '\n') {
+            count++;
+            last = p;
+        }
+    }
+    return count;
+}
+
+}  // namespace
 
 Lexer::Lexer(std::string_view source, std::string filename) : m_source(source), m_filename(std::move(filename)) {}
 
@@ -41,23 +163,32 @@ char Lexer::advance() {
     return c;
 }
 
+void Lexer::skip_to(size_t pos) {
+    const char *from = m_source.data() + m_pos;
+    const char *to = m_source.data() + pos;
+    const char *last_newline = nullptr;
+    m_line += count_newlines(from, to, last_newline);
+    m_col = last_newline ? (int)(to - last_newline) : m_col + (int)(to - from);
+    m_pos = pos;
+}
+
 void Lexer::skip_whitespace() {
+    const char *begin = m_source.data();
+    const char *end = begin + m_source.size();
+    const char *p = begin + m_pos;
     while (true) {
-        char c = peek();
-        if (std::isspace(c)) {
-            advance();
-        } else if (c == '/' && m_source.substr(m_pos).starts_with("//")) {
-            while (peek() != '\n' && peek() != '\0') {
-                advance();
-            }
-        } else {
-            break;
-        }
+        p = skip_spaces(p, end);
+        if (end - p < 2 || p[0] != '/' || p[1] != '/') break;
+        p = find_line_end(p, end);
     }
+    skip_to(p - begin);
 }
 
 std::vector<Token> Lexer::tokenize() {
     std::vector<Token> tokens;
+    // Ether code runs at about one token per 8 bytes; growing a large token vector step by step costs more than
+    // scanning the source
+    tokens.reserve(m_source.size() / 8);
     while (peek() != '\0') {
         skip_whitespace();
         if (peek() == '\0') break;
@@ -76,7 +207,7 @@ Token Lexer::next_token() {
         size_t start_pos = m_pos;
         advance();  // skip '#'
         while (std::isalpha(peek())) advance();
-        std::string lexeme(m_source.substr(start_pos, m_pos - start_pos));
+        std::string_view lexeme = m_source.substr(start_pos, m_pos - start_pos);
         if (lexeme == "#include") {
             return {TokenType::HashInclude, lexeme, start_line, start_col};
         }
@@ -85,14 +216,12 @@ Token Lexer::next_token() {
 
     if (std::isalpha(c) || c == '_') {
         size_t start_pos = m_pos;
-        while (std::isalnum(peek()) || peek() == '_') advance();
-        std::string lexeme(m_source.substr(start_pos, m_pos - start_pos));
+        // Identifiers never span lines
+        m_pos = skip_identifier(m_source.data() + m_pos, m_source.data() + m_source.size()) - m_source.data();
+        m_col += (int)(m_pos - start_pos);
+        std::string_view lexeme = m_source.substr(start_pos, m_pos - start_pos);
 
-        if (keywords.contains(lexeme)) {
-            TokenType type = keywords.at(lexeme);
-            return {type, lexeme, start_line, start_col};
-        }
-        return {TokenType::Identifier, lexeme, start_line, start_col};
+        return {keyword_type(lexeme), lexeme, start_line, start_col};
     }
 
     if (std::isdigit(c)) {
@@ -102,92 +231,35 @@ Token Lexer::next_token() {
         if (peek() == '.') {
             advance();  // eat '.'
             while (std::isdigit(peek())) advance();
-            return {TokenType::FloatLiteral, std::string(m_source.substr(start_pos, m_pos - start_pos)), start_line,
-                    start_col};
+            return {TokenType::FloatLiteral, m_source.substr(start_pos, m_pos - start_pos), start_line, start_col};
         }
 
-        return {TokenType::IntegerLiteral, std::string(m_source.substr(start_pos, m_pos - start_pos)), start_line,
-                start_col};
+        return {TokenType::IntegerLiteral, m_source.substr(start_pos, m_pos - start_pos), start_line, start_col};
     }
 
-    if (c == '"') {
-        advance();  // skip opening "
-        std::string value;
-        while (peek() != '"' && peek() != '\0') {
-            if (peek() == '\\') {
-                advance();  // skip '\'
-                char escaped = advance();
-                switch (escaped) {
-                    case 'n':
-                        value += '\n';
-                        break;
-                    case 't':
-                        value += '\t';
-                        break;
-                    case 'r':
-                        value += '\r';
-                        break;
-                    case '\\':
-                        value += '\\';
-                        break;
-                    case '"':
-                        value += '"';
-                        break;
-                    default:
-                        value += escaped;
-                        break;
-                }
-            } else {
-                value += advance();
-            }
+    if (c == '"' || c == '\'') {
+        advance();  // skip opening quote
+        size_t start_pos = m_pos;
+        const char *end = m_source.data() + m_source.size();
+        const char *p = find_literal_stop(m_source.data() + m_pos, end, c);
+        while (p < end && *p == '\\') {
+            p = find_literal_stop(p + std::min<ptrdiff_t>(2, end - p), end, c);
         }
-        if (peek() == '"') {
-            advance();  // skip closing "
-            return {TokenType::StringLiteral, value, start_line, start_col};
-        } else {
-            throw CompilerError("Unterminated string literal", m_filename, start_line, start_col);
-        }
-    }
-
-    if (c == '\'') {
-        advance();  // skip opening '
-        char value = '\0';
-        if (peek() == '\\') {
-            advance();  // skip '\'
-            char escaped = advance();
-            switch (escaped) {
-                case 'n':
-                    value = '\n';
-                    break;
-                case 't':
-                    value = '\t';
-                    break;
-                case 'r':
-                    value = '\r';
-                    break;
-                case '\\':
-                    value = '\\';
-                    break;
-                case '\'':
-                    value = '\'';
-                    break;
-                default:
-                    value = escaped;
-                    break;
-            }
-        } else {
-            value = advance();
-        }
-        if (peek() == '\'') {
-            advance();  // skip closing '
-            return {TokenType::IntegerLiteral, std::to_string((int)value), start_line, start_col};
-        } else {
-            throw CompilerError("Unterminated char literal", m_filename, start_line, start_col);
+        skip_to(p - m_source.data());
+        std::string_view text = m_source.substr(start_pos, m_pos - start_pos);
+        bool single_char = text.size() == 1 || (text.size() == 2 && text[0] == '\\');
+        if (peek() != c || (c == '\'' && !single_char)) {
+            throw CompilerError(c == '"' ? "Unterminated string literal" : "Unterminated char literal", m_filename,
+                                start_line, start_col);
         }
+        advance();  // skip closing quote
+        if (c == '\'') return {TokenType::IntegerLiteral, m_source.substr(start_pos - 1, m_pos - start_pos + 1),
+                                start_line, start_col};
+        return {TokenType::StringLiteral, text, start_line, start_col};
     }
 
     advance();
-    std::string lexeme(m_source.substr(m_pos - 1, 1));
+    std::string_view lexeme = m_source.substr(m_pos - 1, 1);
 
     switch (c) {
         case '+': {
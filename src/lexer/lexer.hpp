@@ -1,6 +1,8 @@
 #ifndef ETHER_LEXER_HPP
 #define ETHER_LEXER_HPP
 
+#include <cstdint>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -8,6 +10,11 @@
 
 namespace ether::lexer {
 
+// The text of a string or char literal with its escape sequences replaced
+std::string unescape(std::string_view text);
+// The value of an IntegerLiteral token, written in decimal or as a char literal
+int64_t integer_value(std::string_view lexeme);
+
 class Lexer {
    public:
     explicit Lexer(std::string_view source, std::string filename);
@@ -22,6 +29,8 @@ class Lexer {
 
     char peek() const;
     char advance();
+    // Moves to `pos`, counting the newlines on the way in bulk
+    void skip_to(size_t pos);
     void skip_whitespace();
     Token next_token();
 };
@@ -1,7 +1,7 @@
 #ifndef ETHER_TOKEN_HPP
 #define ETHER_TOKEN_HPP
 
-#include <string>
+#include <string_view>
 
 namespace ether::lexer {
 
@@ -24,6 +24,7 @@ enum class TokenType {
     Yield,
     Await,
     String,
+    Bytes,
     Ptr,
     Void,
     Struct,
@@ -66,9 +67,12 @@ enum class TokenType {
     Unknown
 };
 
+// Tokens point into the source they were lexed from, which must outlive them. Literals keep their text as written:
+// a string literal between its quotes, a char literal (an IntegerLiteral) with them. See unescape() and
+// integer_value().
 struct Token {
     TokenType type;
-    std::string lexeme;
+    std::string_view lexeme;
     int line;
     int column;
 };
@@ -2,6 +2,9 @@
 
 #include <iostream>
 
+#include "common/error.hpp"
+#include "lexer/keywords.hpp"
+#include "lexer/lexer.hpp"
 #include "parser/ast.hpp"
 
 namespace ether::lsp {
@@ -13,7 +16,7 @@ void SemanticTokensVisitor::highlight_complex_type(const DataType &type, int lin
         tokens.push_back({line, start_col, (int)type.struct_name.size(), 3});
     } else if (type.kind == DataType::Kind::Ptr && type.inner) {
         // "ptr" is keyword (offset 0), inner starts at offset 4 "ptr("
-        // But we rely on lexer coloring "ptr". We iterate inside.
+        // "ptr" itself is colored by add_keyword_tokens. We iterate inside.
         highlight_complex_type(*type.inner, line, start_col + 4);
     } else if (type.kind == DataType::Kind::Coroutine && type.inner) {
         // "coroutine(" -> 10 chars
@@ -188,4 +191,17 @@ void SemanticTokensVisitor::visit(const VarargExpression &node) {
     if (node.filename != target_filename) return;
 }
 
+void add_keyword_tokens(std::string_view source, const std::string &filename, std::vector<SemanticToken> &tokens) {
+    try {
+        lexer::Lexer lexer(source, filename);
+        for (const auto &token : lexer.tokenize()) {
+            if (lexer::is_keyword(token.type)) {
+                tokens.push_back({token.line, token.column, (int)token.lexeme.size(), 4});
+            }
+        }
+    } catch (const CompilerError &) {
+        // Being edited; the AST tokens still come through
+    }
+}
+
 }  // namespace ether::lsp
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "parser/ast.hpp"
@@ -57,4 +58,8 @@ struct SemanticTokensVisitor : public parser::ConstASTVisitor {
     void visit(const parser::VarargExpression &node) override;
 };
 
+// Keywords are colored straight from the lexer's keyword table; type 4 (keyword). A source that does not lex yields
+// none.
+void add_keyword_tokens(std::string_view source, const std::string &filename, std::vector<SemanticToken> &tokens);
+
 }  // namespace ether::lsp
@@ -12,7 +12,7 @@
 #include "lsp/node_finder.hpp"
 #include "lsp/protocol.hpp"
 #include "lsp/semantic_tokens.hpp"
-#include "parser/parser.hpp"
+#include "parser/include_graph.hpp"
 #include "sema/analyzer.hpp"
 
 namespace ether::lsp {
@@ -85,7 +85,7 @@ void LSPServer::on_initialize(const std::string& id, const std::string& params)
                   "\"hoverProvider\":true,"
                   "\"semanticTokensProvider\":{"
                   "\"legend\":{"
-                  "\"tokenTypes\":[\"function\", \"variable\", \"parameter\", \"type\"],"
+                  "\"tokenTypes\":[\"function\", \"variable\", \"parameter\", \"type\", \"keyword\"],"
                   "\"tokenModifiers\":[]"
                   "},"
                   "\"full\":true"
@@ -254,6 +254,7 @@ void LSPServer::on_semantic_tokens(const std::string& id, const std::string& par
 
     SemanticTokensVisitor visitor(uri);
     doc.ast->accept(visitor);
+    add_keyword_tokens(doc.source, uri, visitor.tokens);
     std::stable_sort(visitor.tokens.begin(), visitor.tokens.end());
 
     std::vector<int> data;
@@ -315,8 +316,7 @@ void LSPServer::process_file(const std::string& filename, const std::string& sou
         std::cerr << "[LSP] Analyzing file: " << filename << std::endl;
         ether::lexer::Lexer lexer(source, filename);
         auto tokens = lexer.tokenize();
-        ether::parser::Parser parser(tokens, filename);
-        auto program_ast = parser.parse_program();
+        auto program_ast = ether::parser::parse_with_includes(tokens, filename, &m_ast_cache);
 
         // Store AST now, so even if sema fails, the LSP has the latest structural info
         auto* ast_ptr = program_ast.get();
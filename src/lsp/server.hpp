@@ -8,6 +8,7 @@
 
 #include "common/error.hpp"
 #include "parser/ast.hpp"
+#include "parser/ast_cache.hpp"
 
 namespace ether::lsp {
 
@@ -39,6 +40,7 @@ class LSPServer {
     };
 
     std::unordered_map<std::string, Document> m_documents;
+    parser::AstCache m_ast_cache;  // Included files, shared by every document and reparse
 
     void process_file(const std::string& filename, const std::string& source);
 };
@@ -3,18 +3,24 @@
 #include <chrono>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <thread>
 
 #include "common/error.hpp"
+#include "driver/bytecode_cache.hpp"
 #include "driver/driver_utils.hpp"
+#include "driver/vm_flags.hpp"
+#include "ir/bytecode_file.hpp"
 #include "ir/disassembler.hpp"
 #include "ir/ir.hpp"
 #include "ir/ir_gen.hpp"
 #include "lexer/lexer.hpp"
 #include "lsp/server.hpp"
-#include "parser/parser.hpp"
+#include "opt/constant_folder.hpp"
+#include "opt/pass_manager.hpp"
+#include "parser/include_graph.hpp"
 #include "sema/analyzer.hpp"
 #include "test_runner/test_runner.hpp"
 #include "vm/vm.hpp"
@@ -64,6 +70,10 @@ int main(int argc, char *argv[]) {
     std::string filename = first_arg;
     bool dump_ir = false;
     bool show_stats = false;
+    bool optimize = true;
+    bool use_cache = true;
+    std::string emit_path;
+    ether::vm::VMOptions vm_options;
 
     for (int i = 2; i < argc; ++i) {
         std::string arg = argv[i];
@@ -71,47 +81,94 @@ int main(int argc, char *argv[]) {
             dump_ir = true;
         } else if (arg == "--stats") {
             show_stats = true;
+        } else if (arg == "-O0") {
+            optimize = false;
+        } else if (arg == "--no-cache") {
+            use_cache = false;
+        } else if (arg == "--emit-bytecode" && i + 1 < argc) {
+            emit_path = argv[++i];
+        } else {
+            try {
+                ether::driver::parse_vm_flag(argc, argv, i, vm_options);
+            } catch (const std::exception &e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
         }
     }
 
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Could not open file: " << filename << std::endl;
-        return 1;
+    // A precompiled image skips the front end entirely
+    bool is_image = filename.ends_with(".ethc");
+    std::string source;
+    if (!is_image) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            std::cerr << "Could not open file: " << filename << std::endl;
+            return 1;
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        source = buffer.str();
     }
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string source = buffer.str();
-
     time_point start_total, end_total, t1, t2, t3, t4, t5, t6, t7;
     try {
         if (show_stats) start_total = Clock::now();
+        if (show_stats) t1 = t2 = t3 = t4 = t5 = Clock::now();
+
+        ether::ir::IRProgram program;
+        std::optional<ether::ir::MappedImage> image;
+        std::string cache_path;
+        if (is_image) {
+            image.emplace(filename);
+        } else if (use_cache && emit_path.empty()) {
+            cache_path = ether::driver::cache_path_for(filename, optimize);
+            if (!cache_path.empty()) image = ether::driver::load_cached(cache_path, source);
+        }
 
-        if (show_stats) t1 = Clock::now();
-        ether::lexer::Lexer lexer(source, filename);
-        auto tokens = lexer.tokenize();
-        if (show_stats) t2 = Clock::now();
+        if (!image) {
+            if (show_stats) t1 = Clock::now();
+            ether::lexer::Lexer lexer(source, filename);
+            auto tokens = lexer.tokenize();
+            if (show_stats) t2 = Clock::now();
 
-        ether::parser::Parser parser(tokens, filename);
-        auto program_ast = parser.parse_program();
-        if (show_stats) t3 = Clock::now();
+            auto program_ast = ether::parser::parse_with_includes(tokens, filename);
+            if (show_stats) t3 = Clock::now();
 
-        ether::sema::Analyzer analyzer;
-        analyzer.analyze(*program_ast);
-        if (show_stats) t4 = Clock::now();
+            ether::sema::Analyzer analyzer;
+            analyzer.analyze(*program_ast);
+            if (optimize) {
+                ether::opt::ConstantFolder folder;
+                folder.fold(*program_ast);
+            }
+            if (show_stats) t4 = Clock::now();
 
-        ether::ir_gen::IRGenerator ir_gen;
-        ether::ir::IRProgram program = ir_gen.generate(*program_ast);
-        if (show_stats) t5 = Clock::now();
+            ether::ir_gen::IRGenerator ir_gen(optimize);
+            program = ir_gen.generate(*program_ast);
+            if (optimize) {
+                ether::opt::PassManager::standard().run(program);
+            }
+            if (show_stats) t5 = Clock::now();
+
+            if (!emit_path.empty() || !cache_path.empty()) {
+                ether::ir::BytecodeImage image{std::move(program), optimize,
+                                               ether::driver::collect_dependencies(filename, source, *program_ast)};
+                if (!emit_path.empty()) {
+                    ether::ir::write_bytecode_file(emit_path, image);
+                    return 0;
+                }
+                ether::driver::store_cached(cache_path, image);
+                program = std::move(image.program);
+            }
+        }
 
         if (dump_ir) {
-            ether::ir::disassemble(program);
+            ether::ir::disassemble(image ? image->to_program() : program);
             return 0;
         }
 
         if (show_stats) t6 = Clock::now();
-        ether::vm::VM vm(program);
+        ether::vm::VM vm(image ? image->view() : ether::ir::ProgramView::of(program), vm_options);
         ether::vm::Value result = vm.run(show_stats);
         if (show_stats) t7 = Clock::now();
         if (show_stats) end_total = Clock::now();
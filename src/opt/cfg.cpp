@@ -0,0 +1,329 @@
+#include "cfg.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <stdexcept>
+
+namespace ether::opt {
+
+const OpInfo &op_info(ir::OpCode op) {
+    static const OpInfo none{0, 0, 0}, push8{8, 0, 1}, push4{4, 0, 1}, push2{2, 0, 1}, push1{1, 0, 1},
+        load_slot{2, 0, 1}, store_slot{2, 1, 0}, binary{0, 2, 1}, unary{0, 1, 1}, pop1{0, 1, 0}, jump{4, 0, 0},
+        cond_jump{4, 1, 0}, call{5, -1, 1}, syscall{1, -1, 1}, syscall_n{3, -1, 1}, str_set{0, 3, 0},
+        arr_alloc{8, 0, 1}, load_ptr{4, 1, 1}, store_ptr{4, 2, 0}, index{2, 2, 1}, varargs{0, 0, -1},
+        tail_call{5, -1, 0}, frame_alloc{6, 0, 1};
+    switch (op) {
+        case ir::OpCode::PUSH_I64:
+        case ir::OpCode::PUSH_F64:
+            return push8;
+        case ir::OpCode::PUSH_I32:
+        case ir::OpCode::PUSH_F32:
+        case ir::OpCode::PUSH_STR:
+        case ir::OpCode::STRUCT_ALLOC:
+            return push4;
+        case ir::OpCode::PUSH_I16:
+            return push2;
+        case ir::OpCode::PUSH_I8:
+            return push1;
+        case ir::OpCode::LOAD_VAR:
+        case ir::OpCode::LOAD_VAR_BORROW:
+        case ir::OpCode::LOAD_VAR_MOVE:
+        case ir::OpCode::LOAD_GLOBAL:
+            return load_slot;
+        case ir::OpCode::STORE_VAR:
+        case ir::OpCode::STORE_GLOBAL:
+            return store_slot;
+        case ir::OpCode::ADD:
+        case ir::OpCode::SUB:
+        case ir::OpCode::MUL:
+        case ir::OpCode::DIV:
+        case ir::OpCode::ADD_F:
+        case ir::OpCode::SUB_F:
+        case ir::OpCode::MUL_F:
+        case ir::OpCode::DIV_F:
+        case ir::OpCode::CMP_EQ:
+        case ir::OpCode::CMP_LE:
+        case ir::OpCode::CMP_LT:
+        case ir::OpCode::CMP_GT:
+        case ir::OpCode::CMP_GE:
+        case ir::OpCode::CMP_EQ_F:
+        case ir::OpCode::CMP_LE_F:
+        case ir::OpCode::CMP_LT_F:
+        case ir::OpCode::CMP_GT_F:
+        case ir::OpCode::CMP_GE_F:
+        case ir::OpCode::STR_GET:
+        case ir::OpCode::LOAD_BYTE:
+            return binary;
+        case ir::OpCode::RET:
+        case ir::OpCode::POP:
+            return pop1;
+        case ir::OpCode::AWAIT:
+            return unary;
+        case ir::OpCode::HALT:
+        case ir::OpCode::YIELD:
+            return none;
+        case ir::OpCode::STR_SET:
+            return str_set;
+        case ir::OpCode::ARR_ALLOC:
+            return arr_alloc;
+        case ir::OpCode::SYSCALL:
+            return syscall;
+        case ir::OpCode::SYSCALL_N:
+            return syscall_n;
+        case ir::OpCode::CALL:
+        case ir::OpCode::SPAWN:
+            return call;
+        case ir::OpCode::TAIL_CALL:
+            return tail_call;
+        case ir::OpCode::JMP:
+            return jump;
+        case ir::OpCode::JZ:
+        case ir::OpCode::JNZ:
+            return cond_jump;
+        case ir::OpCode::PUSH_VARARGS:
+            return varargs;
+        case ir::OpCode::LOAD_PTR_OFFSET:
+            return load_ptr;
+        case ir::OpCode::STORE_PTR_OFFSET:
+            return store_ptr;
+        case ir::OpCode::LOAD_INDEX:
+        case ir::OpCode::INDEX_ADDR:
+            return index;
+        case ir::OpCode::FRAME_ALLOC:
+            return frame_alloc;
+    }
+    throw std::runtime_error("Unknown opcode " + std::to_string((int)op));
+}
+
+bool is_branch(ir::OpCode op) { return op == ir::OpCode::JMP || op == ir::OpCode::JZ || op == ir::OpCode::JNZ; }
+
+bool is_terminator(ir::OpCode op) {
+    return op == ir::OpCode::JMP || op == ir::OpCode::RET || op == ir::OpCode::HALT || op == ir::OpCode::TAIL_CALL;
+}
+
+void FunctionCFG::rebuild_edges() {
+    for (auto &block : blocks) {
+        block.successors.clear();
+        block.predecessors.clear();
+    }
+    for (int b = 0; b < (int)blocks.size(); ++b) {
+        auto &block = blocks[b];
+        bool falls_through = true;
+        if (!block.instructions.empty()) {
+            const auto &last = block.instructions.back();
+            if (is_branch(last.op)) block.successors.push_back(last.target);
+            falls_through = !is_terminator(last.op);
+        }
+        if (falls_through && b + 1 < (int)blocks.size() &&
+            std::find(block.successors.begin(), block.successors.end(), b + 1) == block.successors.end()) {
+            block.successors.push_back(b + 1);
+        }
+        for (int succ : block.successors) blocks[succ].predecessors.push_back(b);
+    }
+}
+
+std::vector<int> FunctionCFG::reverse_postorder() const {
+    std::vector<int> order;
+    std::vector<bool> visited(blocks.size(), false);
+    // Iterative DFS: (block, next successor to visit)
+    std::vector<std::pair<int, size_t>> stack;
+    if (!blocks.empty()) {
+        stack.push_back({0, 0});
+        visited[0] = true;
+    }
+    while (!stack.empty()) {
+        auto &[b, next] = stack.back();
+        if (next < blocks[b].successors.size()) {
+            int succ = blocks[b].successors[next++];
+            if (!visited[succ]) {
+                visited[succ] = true;
+                stack.push_back({succ, 0});
+            }
+        } else {
+            order.push_back(b);
+            stack.pop_back();
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+void FunctionCFG::compute_dominators() {
+    // Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm"
+    std::vector<int> rpo = reverse_postorder();
+    std::vector<int> rpo_index(blocks.size(), -1);
+    for (int i = 0; i < (int)rpo.size(); ++i) rpo_index[rpo[i]] = i;
+
+    idom.assign(blocks.size(), -1);
+    if (rpo.empty()) return;
+    idom[0] = 0;
+
+    auto intersect = [&](int a, int b) {
+        while (a != b) {
+            while (rpo_index[a] > rpo_index[b]) a = idom[a];
+            while (rpo_index[b] > rpo_index[a]) b = idom[b];
+        }
+        return a;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < rpo.size(); ++i) {
+            int b = rpo[i];
+            int new_idom = -1;
+            for (int pred : blocks[b].predecessors) {
+                if (idom[pred] == -1) continue;
+                new_idom = new_idom == -1 ? pred : intersect(pred, new_idom);
+            }
+            if (new_idom != idom[b]) {
+                idom[b] = new_idom;
+                changed = true;
+            }
+        }
+    }
+    idom[0] = -1;
+}
+
+bool FunctionCFG::dominates(int a, int b) const {
+    if (b != 0 && idom[b] == -1) return false;  // Unreachable
+    while (b != -1) {
+        if (a == b) return true;
+        b = idom[b];
+    }
+    return false;
+}
+
+std::vector<int> FunctionCFG::dominator_preorder() const {
+    std::vector<std::vector<int>> children(blocks.size());
+    for (int b = 1; b < (int)blocks.size(); ++b) {
+        if (idom[b] != -1) children[idom[b]].push_back(b);
+    }
+    std::vector<int> order;
+    std::vector<int> stack;
+    if (!blocks.empty()) stack.push_back(0);
+    while (!stack.empty()) {
+        int b = stack.back();
+        stack.pop_back();
+        order.push_back(b);
+        for (auto it = children[b].rbegin(); it != children[b].rend(); ++it) stack.push_back(*it);
+    }
+    return order;
+}
+
+void FunctionCFG::remove_blocks(const std::vector<bool> &remove) {
+    std::vector<int> new_index(blocks.size(), -1);
+    std::vector<BasicBlock> kept;
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        if (remove[b]) continue;
+        new_index[b] = (int)kept.size();
+        kept.push_back(std::move(blocks[b]));
+    }
+    for (auto &block : kept) {
+        for (auto &instr : block.instructions) {
+            if (instr.target == -1) continue;
+            if (new_index[instr.target] == -1) throw std::runtime_error("Removed a block that is still a jump target");
+            instr.target = new_index[instr.target];
+        }
+    }
+    blocks = std::move(kept);
+    rebuild_edges();
+    compute_dominators();
+}
+
+static FunctionCFG build_cfg(const std::vector<uint8_t> &code, size_t start, size_t end) {
+    struct Decoded {
+        size_t addr;
+        Instruction instr;
+    };
+    std::vector<Decoded> decoded;
+    std::map<size_t, int> leaders{{start, 0}};
+    for (size_t ip = start; ip < end;) {
+        Instruction instr{(ir::OpCode)code[ip]};
+        size_t size = op_info(instr.op).operand_size;
+        std::memcpy(&instr.operand, &code[ip + 1], size);
+        decoded.push_back({ip, instr});
+        ip += 1 + size;
+        if (is_branch(instr.op)) {
+            if (instr.operand < start || instr.operand >= end) {
+                throw std::runtime_error("Jump at " + std::to_string(ip) + " leaves its function");
+            }
+            leaders[instr.operand] = 0;
+        }
+        if ((is_branch(instr.op) || is_terminator(instr.op)) && ip < end) leaders[ip] = 0;
+    }
+
+    int index = 0;
+    for (auto &[addr, block] : leaders) block = index++;
+
+    FunctionCFG cfg;
+    cfg.entry_addr = start;
+    cfg.blocks.resize(leaders.size());
+    int current = -1;
+    for (auto &[addr, instr] : decoded) {
+        if (auto it = leaders.find(addr); it != leaders.end()) current = it->second;
+        if (is_branch(instr.op)) instr.target = leaders.at(instr.operand);
+        cfg.blocks[current].instructions.push_back(instr);
+    }
+    cfg.rebuild_edges();
+    cfg.compute_dominators();
+    return cfg;
+}
+
+std::vector<FunctionCFG> build_cfgs(const ir::IRProgram &program) {
+    std::map<size_t, const ir::IRProgram::FunctionInfo *> entries;
+    for (const auto &info : program.function_table) entries[info.entry_addr] = &info;
+
+    std::vector<size_t> bounds{0};
+    for (const auto &[addr, info] : entries) {
+        if (addr != 0) bounds.push_back(addr);
+    }
+    bounds.push_back(program.bytecode.size());
+
+    std::vector<FunctionCFG> cfgs;
+    for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+        FunctionCFG cfg = build_cfg(program.bytecode, bounds[i], bounds[i + 1]);
+        if (auto it = entries.find(bounds[i]); it != entries.end()) {
+            cfg.num_params = it->second->num_params;
+            cfg.num_slots = it->second->num_slots;
+        }
+        cfgs.push_back(std::move(cfg));
+    }
+    return cfgs;
+}
+
+void emit_cfgs(const std::vector<FunctionCFG> &cfgs, ir::IRProgram &program) {
+    std::vector<uint8_t> code;
+    std::map<size_t, size_t> moved_entries;
+    std::vector<std::pair<size_t, const Instruction *>> jumps;
+
+    for (const auto &cfg : cfgs) {
+        moved_entries[cfg.entry_addr] = code.size();
+        std::vector<size_t> block_addr(cfg.blocks.size());
+        size_t first_jump = jumps.size();
+        for (size_t b = 0; b < cfg.blocks.size(); ++b) {
+            block_addr[b] = code.size();
+            for (const auto &instr : cfg.blocks[b].instructions) {
+                code.push_back((uint8_t)instr.op);
+                size_t size = op_info(instr.op).operand_size;
+                if (is_branch(instr.op)) jumps.push_back({code.size(), &instr});
+                code.resize(code.size() + size);
+                std::memcpy(&code[code.size() - size], &instr.operand, size);
+            }
+        }
+        for (size_t j = first_jump; j < jumps.size(); ++j) {
+            uint32_t target = (uint32_t)block_addr[jumps[j].second->target];
+            std::memcpy(&code[jumps[j].first], &target, 4);
+        }
+    }
+
+    program.bytecode = std::move(code);
+    for (auto &info : program.function_table) info.entry_addr = moved_entries.at(info.entry_addr);
+    for (auto &[name, info] : program.functions) {
+        if (info.entry_addr != ir::IRProgram::NativeCall) info.entry_addr = moved_entries.at(info.entry_addr);
+    }
+}
+
+}  // namespace ether::opt
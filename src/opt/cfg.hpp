@@ -0,0 +1,60 @@
+#ifndef ETHER_OPT_CFG_HPP
+#define ETHER_OPT_CFG_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ir/ir.hpp"
+
+namespace ether::opt {
+
+struct Instruction {
+    ir::OpCode op;
+    uint64_t operand = 0;  // Raw immediate bytes, little-endian; CALL/SPAWN keep num_args in byte 4
+    int target = -1;       // Block index for JMP/JZ/JNZ
+};
+
+struct BasicBlock {
+    std::vector<Instruction> instructions;
+    std::vector<int> successors;
+    std::vector<int> predecessors;
+};
+
+// One function's bytecode (or the global initialization code before it) split into basic blocks, kept in layout
+// order so a block without a terminator falls through to the next one.
+struct FunctionCFG {
+    size_t entry_addr = 0;
+    uint8_t num_params = 0;
+    uint32_t num_slots = 0;
+    std::vector<BasicBlock> blocks;
+    std::vector<int> idom;  // Immediate dominator of each block; -1 for the entry and for unreachable blocks
+
+    void rebuild_edges();
+    std::vector<int> reverse_postorder() const;
+    void compute_dominators();
+    bool dominates(int a, int b) const;
+    // Blocks in dominator tree preorder, so every block comes after its immediate dominator
+    std::vector<int> dominator_preorder() const;
+    // Drops the blocks flagged in `remove`, renumbering jump targets; none of them may be a jump target
+    void remove_blocks(const std::vector<bool> &remove);
+};
+
+struct OpInfo {
+    uint8_t operand_size;
+    int8_t pops;  // -1 when it depends on the argument count
+    int8_t pushes;
+};
+const OpInfo &op_info(ir::OpCode op);
+bool is_branch(ir::OpCode op);
+// JMP, RET, TAIL_CALL and HALT never continue to the next instruction
+bool is_terminator(ir::OpCode op);
+
+// Splits the program into the global initialization code and one graph per function
+std::vector<FunctionCFG> build_cfgs(const ir::IRProgram &program);
+// Lays the graphs back out as bytecode, updating jump targets and function entry addresses
+void emit_cfgs(const std::vector<FunctionCFG> &cfgs, ir::IRProgram &program);
+
+}  // namespace ether::opt
+
+#endif  // ETHER_OPT_CFG_HPP
@@ -0,0 +1,387 @@
+#include "constant_folder.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+
+#include "ir/ir_gen.hpp"
+
+namespace ether::opt {
+
+using parser::BinaryExpression;
+using parser::DataType;
+
+namespace {
+
+std::string var_key(const std::string &name, const std::string &filename, int line, int col) {
+    return filename + ":" + std::to_string(line) + ":" + std::to_string(col) + ":" + name;
+}
+
+std::string var_key(const parser::VariableExpression &node) {
+    return var_key(node.name, node.decl_filename, node.decl_line, node.decl_col);
+}
+
+// Records every variable that is written after its declaration.
+struct ReassignmentCollector : public parser::ConstASTVisitor {
+    std::unordered_set<std::string> &reassigned;
+    explicit ReassignmentCollector(std::unordered_set<std::string> &out) : reassigned(out) {}
+
+    void written(const parser::Expression &lvalue) {
+        if (auto *var = dynamic_cast<const parser::VariableExpression *>(&lvalue)) {
+            reassigned.insert(var_key(*var));
+        }
+        lvalue.accept(*this);
+    }
+
+    void visit(const parser::IntegerLiteral &) override {}
+    void visit(const parser::FloatLiteral &) override {}
+    void visit(const parser::StringLiteral &) override {}
+    void visit(const parser::VariableExpression &) override {}
+    void visit(const parser::FunctionCall &node) override {
+        if (node.object) node.object->accept(*this);
+        for (const auto &arg : node.args) arg->accept(*this);
+    }
+    void visit(const parser::VarargExpression &) override {}
+    void visit(const parser::BinaryExpression &node) override {
+        node.left->accept(*this);
+        node.right->accept(*this);
+    }
+    void visit(const parser::Block &node) override {
+        for (const auto &stmt : node.statements) stmt->accept(*this);
+    }
+    void visit(const parser::IfStatement &node) override {
+        node.condition->accept(*this);
+        node.then_branch->accept(*this);
+        if (node.else_branch) node.else_branch->accept(*this);
+    }
+    void visit(const parser::ReturnStatement &node) override {
+        if (node.expr) node.expr->accept(*this);
+    }
+    void visit(const parser::ExpressionStatement &node) override { node.expr->accept(*this); }
+    void visit(const parser::YieldStatement &) override {}
+    void visit(const parser::SpawnExpression &node) override { node.call->accept(*this); }
+    void visit(const parser::AssignmentExpression &node) override {
+        written(*node.lvalue);
+        node.value->accept(*this);
+    }
+    void visit(const parser::IncrementExpression &node) override { written(*node.lvalue); }
+    void visit(const parser::DecrementExpression &node) override { written(*node.lvalue); }
+    void visit(const parser::AwaitExpression &node) override { node.expr->accept(*this); }
+    void visit(const parser::ForStatement &node) override {
+        if (node.init) node.init->accept(*this);
+        if (node.condition) node.condition->accept(*this);
+        if (node.increment) node.increment->accept(*this);
+        node.body->accept(*this);
+    }
+    void visit(const parser::VariableDeclaration &node) override {
+        if (node.init) node.init->accept(*this);
+    }
+    void visit(const parser::Function &node) override { node.body->accept(*this); }
+    void visit(const parser::Include &) override {}
+    void visit(const parser::StructDeclaration &) override {}
+    void visit(const parser::EnumDeclaration &) override {}
+    void visit(const parser::EnumAccessExpression &) override {}
+    void visit(const parser::MemberAccessExpression &node) override { node.object->accept(*this); }
+    void visit(const parser::IndexExpression &node) override {
+        node.object->accept(*this);
+        node.index->accept(*this);
+    }
+    void visit(const parser::SizeofExpression &) override {}
+    void visit(const parser::Program &node) override {
+        for (const auto &global : node.globals) global->accept(*this);
+        for (const auto &func : node.functions) func->accept(*this);
+    }
+};
+
+// A literal's value as the VM sees it after the push, i.e. with the truncation its type implies.
+struct Constant {
+    bool is_float;
+    int64_t i;
+    double f;
+};
+
+std::optional<Constant> constant_of(const parser::Expression &expr) {
+    if (auto *lit = dynamic_cast<const parser::IntegerLiteral *>(&expr)) {
+        auto kind = lit->type ? lit->type->kind : DataType::Kind::I32;
+        switch (kind) {
+            case DataType::Kind::I64:
+                return Constant{false, lit->value, 0};
+            case DataType::Kind::I16:
+                return Constant{false, (int16_t)lit->value, 0};
+            case DataType::Kind::I8:
+                return Constant{false, (int8_t)lit->value, 0};
+            default:
+                return Constant{false, (int32_t)lit->value, 0};
+        }
+    }
+    if (auto *lit = dynamic_cast<const parser::FloatLiteral *>(&expr)) {
+        return Constant{true, 0, lit->is_f32 ? (double)(float)lit->value : lit->value};
+    }
+    return std::nullopt;
+}
+
+// Value::i64_value() of a float is a plain cast, which is only defined in range.
+std::optional<int64_t> as_i64(const Constant &c) {
+    if (!c.is_float) return c.i;
+    if (!std::isfinite(c.f) || c.f <= -0x1p63 || c.f >= 0x1p63) return std::nullopt;
+    return (int64_t)c.f;
+}
+
+double as_f64(const Constant &c) { return c.is_float ? c.f : (double)c.i; }
+
+std::unique_ptr<parser::Expression> make_literal(const Constant &c, const parser::ASTNode &at) {
+    if (c.is_float) {
+        auto lit = std::make_unique<parser::FloatLiteral>(c.f, false, at.filename, at.line, at.column, at.length);
+        lit->type = std::make_unique<DataType>(DataType::Kind::F64);
+        return lit;
+    }
+    bool fits_i32 = c.i >= std::numeric_limits<int32_t>::min() && c.i <= std::numeric_limits<int32_t>::max();
+    auto lit = std::make_unique<parser::IntegerLiteral>(c.i, at.filename, at.line, at.column, at.length);
+    lit->type = std::make_unique<DataType>(fits_i32 ? DataType::Kind::I32 : DataType::Kind::I64);
+    return lit;
+}
+
+std::unique_ptr<parser::Expression> clone_literal(const parser::Expression &expr, const parser::ASTNode &at) {
+    std::unique_ptr<parser::Expression> copy;
+    if (auto *lit = dynamic_cast<const parser::IntegerLiteral *>(&expr)) {
+        copy = std::make_unique<parser::IntegerLiteral>(lit->value, at.filename, at.line, at.column, at.length);
+    } else if (auto *lit = dynamic_cast<const parser::FloatLiteral *>(&expr)) {
+        copy = std::make_unique<parser::FloatLiteral>(lit->value, lit->is_f32, at.filename, at.line, at.column,
+                                                      at.length);
+    } else {
+        return nullptr;
+    }
+    if (expr.type) copy->type = std::make_unique<DataType>(*expr.type);
+    return copy;
+}
+
+// Mirrors the VM: the left operand's type picks the integer or float opcode, arithmetic results are i64 or f64 and
+// comparisons push an i32 0/1.
+std::optional<Constant> evaluate(BinaryExpression::Op op, bool is_float, const Constant &l, const Constant &r) {
+    auto cmp = [](bool v) { return Constant{false, v ? 1 : 0, 0}; };
+    if (is_float) {
+        double a = as_f64(l), b = as_f64(r);
+        switch (op) {
+            case BinaryExpression::Op::Add:
+                return Constant{true, 0, a + b};
+            case BinaryExpression::Op::Sub:
+                return Constant{true, 0, a - b};
+            case BinaryExpression::Op::Mul:
+                return Constant{true, 0, a * b};
+            case BinaryExpression::Op::Div:
+                return Constant{true, 0, a / b};
+            case BinaryExpression::Op::Eq:
+                return cmp(a == b);
+            case BinaryExpression::Op::Leq:
+                return cmp(a <= b);
+            case BinaryExpression::Op::Less:
+                return cmp(a < b);
+            case BinaryExpression::Op::Gt:
+                return cmp(a > b);
+            case BinaryExpression::Op::Geq:
+                return cmp(a >= b);
+        }
+        return std::nullopt;
+    }
+
+    auto ai = as_i64(l), bi = as_i64(r);
+    if (!ai || !bi) return std::nullopt;
+    int64_t a = *ai, b = *bi;
+    switch (op) {
+        case BinaryExpression::Op::Add:
+            return Constant{false, (int64_t)((uint64_t)a + (uint64_t)b), 0};
+        case BinaryExpression::Op::Sub:
+            return Constant{false, (int64_t)((uint64_t)a - (uint64_t)b), 0};
+        case BinaryExpression::Op::Mul:
+            return Constant{false, (int64_t)((uint64_t)a * (uint64_t)b), 0};
+        case BinaryExpression::Op::Div:
+            // Left for the VM, which traps on these
+            if (b == 0 || (a == std::numeric_limits<int64_t>::min() && b == -1)) return std::nullopt;
+            return Constant{false, a / b, 0};
+        case BinaryExpression::Op::Eq:
+            return cmp(a == b);
+        case BinaryExpression::Op::Leq:
+            return cmp(a <= b);
+        case BinaryExpression::Op::Less:
+            return cmp(a < b);
+        case BinaryExpression::Op::Gt:
+            return cmp(a > b);
+        case BinaryExpression::Op::Geq:
+            return cmp(a >= b);
+    }
+    return std::nullopt;
+}
+
+// How JZ would treat a constant condition, if it is one.
+std::optional<bool> truth_value(const parser::Expression &cond) {
+    auto c = constant_of(cond);
+    if (!c) return std::nullopt;
+    auto v = as_i64(*c);
+    if (!v) return std::nullopt;
+    return *v != 0;
+}
+
+}  // namespace
+
+void ConstantFolder::fold(parser::Program &program) {
+    m_reassigned.clear();
+    m_constants.clear();
+    ReassignmentCollector collector(m_reassigned);
+    program.accept(collector);
+    program.accept(*this);
+}
+
+void ConstantFolder::fold_expr(std::unique_ptr<parser::Expression> &expr) {
+    if (!expr) return;
+    m_expr_replacement.reset();
+    expr->accept(*this);
+    if (m_expr_replacement) expr = std::move(m_expr_replacement);
+}
+
+void ConstantFolder::fold_stmt(std::unique_ptr<parser::Statement> &stmt) {
+    if (!stmt) return;
+    m_stmt_replacement.reset();
+    stmt->accept(*this);
+    if (m_stmt_replacement) stmt = std::move(m_stmt_replacement);
+}
+
+// Assignment targets keep their shape, since IR generation resolves them to a slot or address; only the index
+// expressions inside them are folded.
+void ConstantFolder::fold_lvalue(parser::Expression &lvalue) {
+    if (auto *index = dynamic_cast<parser::IndexExpression *>(&lvalue)) {
+        fold_lvalue(*index->object);
+        fold_expr(index->index);
+    } else if (auto *member = dynamic_cast<parser::MemberAccessExpression *>(&lvalue)) {
+        fold_lvalue(*member->object);
+    } else if (!dynamic_cast<parser::VariableExpression *>(&lvalue)) {
+        lvalue.accept(*this);
+        m_expr_replacement.reset();
+    }
+}
+
+void ConstantFolder::visit(parser::Program &node) {
+    for (auto &global : node.globals) global->accept(*this);
+    for (auto &func : node.functions) func->accept(*this);
+}
+
+void ConstantFolder::visit(parser::Function &node) { node.body->accept(*this); }
+
+void ConstantFolder::visit(parser::Block &node) {
+    for (auto &stmt : node.statements) fold_stmt(stmt);
+}
+
+void ConstantFolder::visit(parser::VariableDeclaration &node) {
+    fold_expr(node.init);
+    if (!node.init || !(node.type.is_integer() || node.type.is_float())) return;
+    std::string key = var_key(node.name, node.filename, node.line, node.column);
+    if (m_reassigned.contains(key)) return;
+    if (auto literal = clone_literal(*node.init, *node.init)) {
+        m_constants[key] = std::move(literal);
+    }
+}
+
+void ConstantFolder::visit(parser::VariableExpression &node) {
+    auto it = m_constants.find(var_key(node));
+    if (it != m_constants.end()) {
+        m_expr_replacement = clone_literal(*it->second, node);
+    }
+}
+
+void ConstantFolder::visit(parser::EnumAccessExpression &node) {
+    m_expr_replacement = make_literal({false, (int32_t)node.value, 0}, node);
+}
+
+void ConstantFolder::visit(parser::SizeofExpression &node) {
+    m_expr_replacement = make_literal({false, (int32_t)ir_gen::IRGenerator::get_type_size(node.target_type), 0}, node);
+}
+
+void ConstantFolder::visit(parser::BinaryExpression &node) {
+    fold_expr(node.left);
+    fold_expr(node.right);
+
+    auto *ls = dynamic_cast<parser::StringLiteral *>(node.left.get());
+    auto *rs = dynamic_cast<parser::StringLiteral *>(node.right.get());
+    if (ls && rs) {
+        if (node.op != BinaryExpression::Op::Add) return;
+        auto joined = std::make_unique<parser::StringLiteral>(ls->value + rs->value, node.filename, node.line,
+                                                              node.column, node.length);
+        joined->type = std::make_unique<DataType>(DataType::Kind::String);
+        m_expr_replacement = std::move(joined);
+        return;
+    }
+
+    auto l = constant_of(*node.left);
+    auto r = constant_of(*node.right);
+    if (!l || !r) return;
+    bool is_float = node.left->type && node.left->type->is_float();
+    if (auto result = evaluate(node.op, is_float, *l, *r)) {
+        m_expr_replacement = make_literal(*result, node);
+    }
+}
+
+void ConstantFolder::visit(parser::IfStatement &node) {
+    fold_expr(node.condition);
+    auto taken = truth_value(*node.condition);
+    if (!taken) {
+        node.then_branch->accept(*this);
+        if (node.else_branch) node.else_branch->accept(*this);
+        return;
+    }
+
+    std::unique_ptr<parser::Block> branch = *taken ? std::move(node.then_branch) : std::move(node.else_branch);
+    if (!branch) {
+        branch = std::make_unique<parser::Block>(node.filename, node.line, node.column, node.length);
+    }
+    branch->accept(*this);
+    m_stmt_replacement = std::move(branch);
+}
+
+void ConstantFolder::visit(parser::ForStatement &node) {
+    fold_stmt(node.init);
+    fold_expr(node.condition);
+    auto taken = node.condition ? truth_value(*node.condition) : std::nullopt;
+    if (taken && !*taken) {
+        // The body never runs, but the initializer still does
+        if (node.init) {
+            m_stmt_replacement = std::move(node.init);
+        } else {
+            m_stmt_replacement = std::make_unique<parser::Block>(node.filename, node.line, node.column, node.length);
+        }
+        return;
+    }
+    if (taken) node.condition.reset();
+    fold_expr(node.increment);
+    node.body->accept(*this);
+}
+
+void ConstantFolder::visit(parser::ReturnStatement &node) { fold_expr(node.expr); }
+
+void ConstantFolder::visit(parser::ExpressionStatement &node) { fold_expr(node.expr); }
+
+void ConstantFolder::visit(parser::FunctionCall &node) {
+    if (node.object) fold_lvalue(*node.object);
+    for (auto &arg : node.args) fold_expr(arg);
+}
+
+void ConstantFolder::visit(parser::SpawnExpression &node) { node.call->accept(*this); }
+
+void ConstantFolder::visit(parser::AssignmentExpression &node) {
+    fold_lvalue(*node.lvalue);
+    fold_expr(node.value);
+}
+
+void ConstantFolder::visit(parser::IncrementExpression &node) { fold_lvalue(*node.lvalue); }
+
+void ConstantFolder::visit(parser::DecrementExpression &node) { fold_lvalue(*node.lvalue); }
+
+void ConstantFolder::visit(parser::AwaitExpression &node) { fold_expr(node.expr); }
+
+void ConstantFolder::visit(parser::MemberAccessExpression &node) { fold_lvalue(*node.object); }
+
+void ConstantFolder::visit(parser::IndexExpression &node) {
+    fold_lvalue(*node.object);
+    fold_expr(node.index);
+}
+
+}  // namespace ether::opt
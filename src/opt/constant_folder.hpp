@@ -0,0 +1,67 @@
+#ifndef ETHER_OPT_CONSTANT_FOLDER_HPP
+#define ETHER_OPT_CONSTANT_FOLDER_HPP
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "parser/ast.hpp"
+
+namespace ether::opt {
+
+// Rewrites the analyzed AST before IR generation:
+//  - integer, float and comparison expressions over literals, enum values and sizeof are evaluated, with the same
+//    result types and truncations the VM would apply at run time, and string literal concatenation is joined;
+//  - if/for statements whose condition is constant lose the branch that can never run;
+//  - numeric locals and globals that are assigned exactly once, at their declaration, with a constant are replaced
+//    by that constant at every use.
+class ConstantFolder : public parser::ASTVisitor {
+   public:
+    void fold(parser::Program &program);
+
+    void visit(parser::IntegerLiteral &node) override {}
+    void visit(parser::FloatLiteral &node) override {}
+    void visit(parser::StringLiteral &node) override {}
+    void visit(parser::VariableExpression &node) override;
+    void visit(parser::FunctionCall &node) override;
+    void visit(parser::VarargExpression &node) override {}
+    void visit(parser::BinaryExpression &node) override;
+    void visit(parser::Block &node) override;
+    void visit(parser::IfStatement &node) override;
+    void visit(parser::ReturnStatement &node) override;
+    void visit(parser::ExpressionStatement &node) override;
+    void visit(parser::YieldStatement &node) override {}
+    void visit(parser::SpawnExpression &node) override;
+    void visit(parser::AssignmentExpression &node) override;
+    void visit(parser::IncrementExpression &node) override;
+    void visit(parser::DecrementExpression &node) override;
+    void visit(parser::AwaitExpression &node) override;
+    void visit(parser::ForStatement &node) override;
+    void visit(parser::VariableDeclaration &node) override;
+    void visit(parser::Function &node) override;
+    void visit(parser::Include &node) override {}
+    void visit(parser::StructDeclaration &node) override {}
+    void visit(parser::EnumDeclaration &node) override {}
+    void visit(parser::EnumAccessExpression &node) override;
+    void visit(parser::MemberAccessExpression &node) override;
+    void visit(parser::IndexExpression &node) override;
+    void visit(parser::SizeofExpression &node) override;
+    void visit(parser::Program &node) override;
+
+   private:
+    // Variables are identified by name plus their declaration site, which sema records on every use.
+    std::unordered_set<std::string> m_reassigned;
+    std::unordered_map<std::string, std::unique_ptr<parser::Expression>> m_constants;
+
+    std::unique_ptr<parser::Expression> m_expr_replacement;
+    std::unique_ptr<parser::Statement> m_stmt_replacement;
+
+    void fold_expr(std::unique_ptr<parser::Expression> &expr);
+    void fold_stmt(std::unique_ptr<parser::Statement> &stmt);
+    void fold_lvalue(parser::Expression &lvalue);
+};
+
+}  // namespace ether::opt
+
+#endif  // ETHER_OPT_CONSTANT_FOLDER_HPP
@@ -0,0 +1,34 @@
+#include "pass_manager.hpp"
+
+#include "opt/passes.hpp"
+
+namespace ether::opt {
+
+PassManager PassManager::standard() {
+    PassManager manager;
+    manager.add(std::make_unique<CopyPropagation>());
+    manager.add(std::make_unique<CommonSubexpressionElimination>());
+    manager.add(std::make_unique<DeadStoreElimination>());
+    manager.add(std::make_unique<DeadCodeElimination>());
+    manager.add_final(std::make_unique<LoadOwnership>());
+    return manager;
+}
+
+void PassManager::run(ir::IRProgram &program) {
+    auto cfgs = build_cfgs(program);
+    for (auto &cfg : cfgs) {
+        for (int round = 0; round < MaxRounds; ++round) {
+            bool changed = false;
+            for (auto &pass : m_passes) {
+                changed |= pass->run(cfg);
+            }
+            if (!changed) break;
+        }
+        for (auto &pass : m_final_passes) {
+            pass->run(cfg);
+        }
+    }
+    emit_cfgs(cfgs, program);
+}
+
+}  // namespace ether::opt
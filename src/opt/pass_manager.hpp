@@ -0,0 +1,41 @@
+#ifndef ETHER_OPT_PASS_MANAGER_HPP
+#define ETHER_OPT_PASS_MANAGER_HPP
+
+#include <memory>
+#include <vector>
+
+#include "ir/ir.hpp"
+#include "opt/cfg.hpp"
+
+namespace ether::opt {
+
+// A transformation over one function's control-flow graph
+class Pass {
+   public:
+    virtual ~Pass() = default;
+    virtual const char *name() const = 0;
+    // Returns whether the function changed
+    virtual bool run(FunctionCFG &cfg) = 0;
+};
+
+// Rebuilds the generated bytecode as basic blocks, runs the passes over every function until none of them finds
+// anything left to do, and lays the result back out.
+class PassManager {
+   public:
+    // Copy propagation, CSE, dead-store elimination and DCE, in that order, then load ownership
+    static PassManager standard();
+
+    void add(std::unique_ptr<Pass> pass) { m_passes.push_back(std::move(pass)); }
+    // Runs once per function after the others have settled
+    void add_final(std::unique_ptr<Pass> pass) { m_final_passes.push_back(std::move(pass)); }
+    void run(ir::IRProgram &program);
+
+   private:
+    static constexpr int MaxRounds = 4;
+    std::vector<std::unique_ptr<Pass>> m_passes;
+    std::vector<std::unique_ptr<Pass>> m_final_passes;
+};
+
+}  // namespace ether::opt
+
+#endif  // ETHER_OPT_PASS_MANAGER_HPP
@@ -0,0 +1,431 @@
+#include "passes.hpp"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+namespace ether::opt {
+
+namespace {
+
+uint16_t slot_of(const Instruction &instr) { return (uint16_t)instr.operand; }
+
+bool is_constant(ir::OpCode op) {
+    switch (op) {
+        case ir::OpCode::PUSH_I64:
+        case ir::OpCode::PUSH_I32:
+        case ir::OpCode::PUSH_I16:
+        case ir::OpCode::PUSH_I8:
+        case ir::OpCode::PUSH_F64:
+        case ir::OpCode::PUSH_F32:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool is_arithmetic(ir::OpCode op) {
+    switch (op) {
+        case ir::OpCode::ADD:
+        case ir::OpCode::SUB:
+        case ir::OpCode::MUL:
+        case ir::OpCode::DIV:
+        case ir::OpCode::ADD_F:
+        case ir::OpCode::SUB_F:
+        case ir::OpCode::MUL_F:
+        case ir::OpCode::DIV_F:
+        case ir::OpCode::CMP_EQ:
+        case ir::OpCode::CMP_LE:
+        case ir::OpCode::CMP_LT:
+        case ir::OpCode::CMP_GT:
+        case ir::OpCode::CMP_GE:
+        case ir::OpCode::CMP_EQ_F:
+        case ir::OpCode::CMP_LE_F:
+        case ir::OpCode::CMP_LT_F:
+        case ir::OpCode::CMP_GT_F:
+        case ir::OpCode::CMP_GE_F:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// One operand stack entry while a block is walked. Inside a block every entry is a single-assignment value, computed
+// by the contiguous instructions [first, position it was pushed at].
+struct StackValue {
+    int first = -1;               // -1 when it came from outside the block or from an instruction with side effects
+    bool pure = false;            // Dropping the computation is unobservable
+    bool numeric = false;         // Never a string, so two equal computations give interchangeable values
+    std::string key;              // Canonical form, when it only reads constants and locals
+    std::vector<uint16_t> reads;  // Locals the key depends on
+};
+
+class ValueTracker {
+   public:
+    // Applies `instr`, found at `index` in the block being built
+    void step(const Instruction &instr, int index) {
+        if (is_constant(instr.op)) {
+            push({index, true, true, std::to_string((int)instr.op) + "#" + std::to_string(instr.operand), {}});
+        } else if (instr.op == ir::OpCode::LOAD_VAR) {
+            push({index, true, false, "v" + std::to_string(slot_of(instr)), {slot_of(instr)}});
+        } else if (instr.op == ir::OpCode::PUSH_STR || instr.op == ir::OpCode::LOAD_GLOBAL) {
+            push({index, true, false, "", {}});
+        } else if (is_arithmetic(instr.op)) {
+            StackValue b = pop();
+            StackValue a = pop();
+            StackValue v;
+            if (a.first != -1 && b.first != -1) {
+                v.first = a.first;
+                // Integer division traps on zero
+                v.pure = a.pure && b.pure && instr.op != ir::OpCode::DIV;
+                v.numeric = instr.op != ir::OpCode::ADD || a.numeric || b.numeric;
+                if (!a.key.empty() && !b.key.empty()) {
+                    v.key = "(" + std::to_string((int)instr.op) + " " + a.key + " " + b.key + ")";
+                    v.reads = std::move(a.reads);
+                    v.reads.insert(v.reads.end(), b.reads.begin(), b.reads.end());
+                }
+            }
+            push(std::move(v));
+        } else {
+            const auto &info = op_info(instr.op);
+            if (info.pops == -1) {
+                m_stack.clear();
+            } else {
+                for (int i = 0; i < info.pops; ++i) pop();
+            }
+            // Nothing below may be treated as one contiguous computation across this instruction
+            for (auto &v : m_stack) v = StackValue{};
+            if (info.pushes == -1) {
+                m_stack.clear();
+            } else {
+                for (int i = 0; i < info.pushes; ++i) push({});
+            }
+        }
+    }
+
+    StackValue pop() {
+        if (m_stack.empty()) return {};
+        StackValue v = std::move(m_stack.back());
+        m_stack.pop_back();
+        return v;
+    }
+    void push(StackValue v) { m_stack.push_back(std::move(v)); }
+    StackValue &top() { return m_stack.back(); }
+    bool empty() const { return m_stack.empty(); }
+
+   private:
+    std::vector<StackValue> m_stack;
+};
+
+// Visits blocks in dominator preorder, handing each block the state its predecessor ended with when that predecessor
+// is the only way in, and a fresh state otherwise.
+template <typename State, typename Fn>
+void walk_extended_blocks(FunctionCFG &cfg, Fn &&fn) {
+    std::vector<State> out(cfg.blocks.size());
+    for (int b : cfg.dominator_preorder()) {
+        const auto &preds = cfg.blocks[b].predecessors;
+        State state = preds.size() == 1 && preds[0] == cfg.idom[b] ? out[preds[0]] : State{};
+        fn(cfg.blocks[b], state);
+        out[b] = std::move(state);
+    }
+}
+
+// PUSH_VARARGS reads the variadic arguments straight out of the slots after the fixed parameters
+void read_varargs(const FunctionCFG &cfg, std::vector<bool> &live) {
+    for (size_t s = cfg.num_params; s < cfg.num_slots; ++s) live[s] = true;
+}
+
+// The locals each block may leave to be read by a later one
+std::vector<std::vector<bool>> slot_liveness(const FunctionCFG &cfg) {
+    size_t n = cfg.num_slots;
+    size_t num_blocks = cfg.blocks.size();
+
+    std::vector<std::vector<bool>> use(num_blocks, std::vector<bool>(n)), def(num_blocks, std::vector<bool>(n));
+    for (size_t b = 0; b < num_blocks; ++b) {
+        for (const auto &instr : cfg.blocks[b].instructions) {
+            if (instr.op == ir::OpCode::LOAD_VAR) {
+                if (!def[b][slot_of(instr)]) use[b][slot_of(instr)] = true;
+            } else if (instr.op == ir::OpCode::STORE_VAR) {
+                def[b][slot_of(instr)] = true;
+            } else if (instr.op == ir::OpCode::PUSH_VARARGS) {
+                for (size_t s = cfg.num_params; s < n; ++s) {
+                    if (!def[b][s]) use[b][s] = true;
+                }
+            }
+        }
+    }
+
+    std::vector<std::vector<bool>> live_in(num_blocks, std::vector<bool>(n)),
+        live_out(num_blocks, std::vector<bool>(n));
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t b = num_blocks; b-- > 0;) {
+            std::vector<bool> out(n);
+            for (int succ : cfg.blocks[b].successors) {
+                for (size_t s = 0; s < n; ++s) out[s] = out[s] || live_in[succ][s];
+            }
+            std::vector<bool> in(n);
+            for (size_t s = 0; s < n; ++s) in[s] = use[b][s] || (out[s] && !def[b][s]);
+            if (in != live_in[b] || out != live_out[b]) {
+                live_in[b] = std::move(in);
+                live_out[b] = std::move(out);
+                changed = true;
+            }
+        }
+    }
+    return live_out;
+}
+
+}  // namespace
+
+bool CopyPropagation::run(FunctionCFG &cfg) {
+    bool changed = false;
+    // Local slot -> the LOAD_VAR or constant push whose value it holds
+    using Copies = std::unordered_map<uint16_t, Instruction>;
+    walk_extended_blocks<Copies>(cfg, [&](BasicBlock &block, Copies &copies) {
+        auto &code = block.instructions;
+        for (size_t i = 0; i < code.size(); ++i) {
+            if (code[i].op == ir::OpCode::LOAD_VAR) {
+                if (auto it = copies.find(slot_of(code[i])); it != copies.end()) {
+                    code[i] = it->second;
+                    changed = true;
+                }
+            } else if (code[i].op == ir::OpCode::STORE_VAR) {
+                uint16_t slot = slot_of(code[i]);
+                std::erase_if(copies, [&](const auto &entry) {
+                    return entry.first == slot ||
+                           (entry.second.op == ir::OpCode::LOAD_VAR && slot_of(entry.second) == slot);
+                });
+                if (i > 0 && (is_constant(code[i - 1].op) ||
+                              (code[i - 1].op == ir::OpCode::LOAD_VAR && slot_of(code[i - 1]) != slot))) {
+                    copies[slot] = code[i - 1];
+                }
+            }
+        }
+    });
+    return changed;
+}
+
+bool CommonSubexpressionElimination::run(FunctionCFG &cfg) {
+    bool changed = false;
+    struct Available {
+        uint16_t slot;
+        std::vector<uint16_t> reads;
+    };
+    using AvailableMap = std::unordered_map<std::string, Available>;
+    walk_extended_blocks<AvailableMap>(cfg, [&](BasicBlock &block, AvailableMap &available) {
+        std::vector<Instruction> out;
+        ValueTracker tracker;
+        for (const auto &instr : block.instructions) {
+            if (instr.op == ir::OpCode::STORE_VAR) {
+                uint16_t slot = slot_of(instr);
+                std::erase_if(available, [&](const auto &entry) {
+                    const auto &reads = entry.second.reads;
+                    return entry.second.slot == slot || std::find(reads.begin(), reads.end(), slot) != reads.end();
+                });
+                if (!tracker.empty()) {
+                    const StackValue &v = tracker.top();
+                    // Single loads and constants are left to copy propagation
+                    bool compound = v.first != -1 && v.first < (int)out.size() - 1;
+                    if (compound && v.numeric && !v.key.empty() &&
+                        std::find(v.reads.begin(), v.reads.end(), slot) == v.reads.end()) {
+                        available[v.key] = {slot, v.reads};
+                    }
+                }
+            }
+
+            out.push_back(instr);
+            tracker.step(instr, (int)out.size() - 1);
+
+            if (!is_arithmetic(instr.op)) continue;
+            StackValue &v = tracker.top();
+            auto it = available.find(v.key);
+            if (v.first == -1 || !v.numeric || v.key.empty() || it == available.end()) continue;
+
+            StackValue reused = tracker.pop();
+            out.resize(reused.first);
+            Instruction load{ir::OpCode::LOAD_VAR, it->second.slot};
+            out.push_back(load);
+            tracker.step(load, (int)out.size() - 1);
+            tracker.top().key = std::move(reused.key);
+            tracker.top().reads = std::move(reused.reads);
+            tracker.top().numeric = true;
+            changed = true;
+        }
+        block.instructions = std::move(out);
+    });
+    return changed;
+}
+
+bool DeadStoreElimination::run(FunctionCFG &cfg) {
+    if (cfg.num_slots == 0) return false;
+    auto live_out = slot_liveness(cfg);
+
+    bool removed = false;
+    for (size_t b = 0; b < cfg.blocks.size(); ++b) {
+        std::vector<bool> live = live_out[b];
+        auto &code = cfg.blocks[b].instructions;
+        for (size_t i = code.size(); i-- > 0;) {
+            if (code[i].op == ir::OpCode::LOAD_VAR) {
+                live[slot_of(code[i])] = true;
+            } else if (code[i].op == ir::OpCode::STORE_VAR) {
+                if (!live[slot_of(code[i])]) {
+                    code[i] = {ir::OpCode::POP};
+                    removed = true;
+                } else {
+                    live[slot_of(code[i])] = false;
+                }
+            } else if (code[i].op == ir::OpCode::PUSH_VARARGS) {
+                read_varargs(cfg, live);
+            }
+        }
+    }
+    return removed;
+}
+
+bool DeadCodeElimination::run(FunctionCFG &cfg) {
+    bool changed = false;
+
+    std::vector<bool> unreachable(cfg.blocks.size(), true);
+    for (int b : cfg.reverse_postorder()) unreachable[b] = false;
+    if (std::find(unreachable.begin(), unreachable.end(), true) != unreachable.end()) {
+        cfg.remove_blocks(unreachable);
+        changed = true;
+    }
+
+    for (size_t b = 0; b < cfg.blocks.size(); ++b) {
+        auto &code = cfg.blocks[b].instructions;
+        if (!code.empty() && code.back().op == ir::OpCode::JMP && code.back().target == (int)b + 1) {
+            code.pop_back();
+            changed = true;
+        }
+
+        std::vector<Instruction> out;
+        ValueTracker tracker;
+        for (const auto &instr : code) {
+            if (instr.op == ir::OpCode::POP && !tracker.empty() && tracker.top().first != -1 && tracker.top().pure) {
+                out.resize(tracker.pop().first);
+                changed = true;
+                continue;
+            }
+            out.push_back(instr);
+            tracker.step(instr, (int)out.size() - 1);
+        }
+        code = std::move(out);
+    }
+
+    if (changed) {
+        cfg.rebuild_edges();
+        cfg.compute_dominators();
+    }
+    return changed;
+}
+
+namespace {
+
+// Instructions that only read their operands, so a borrowed operand is never kept past them. Arguments of a call
+// become the callee's parameters, which cannot outlive this frame; the VM takes a reference for any it stores.
+bool reads_operands(const Instruction &instr) {
+    if (is_arithmetic(instr.op)) return true;
+    switch (instr.op) {
+        case ir::OpCode::POP:
+        case ir::OpCode::JZ:
+        case ir::OpCode::JNZ:
+        case ir::OpCode::STR_GET:
+        case ir::OpCode::LOAD_BYTE:
+        case ir::OpCode::LOAD_PTR_OFFSET:
+        case ir::OpCode::LOAD_INDEX:
+        case ir::OpCode::INDEX_ADDR:
+        case ir::OpCode::STORE_PTR_OFFSET:  // As the pointer, see consumer_of()
+        case ir::OpCode::CALL:
+        case ir::OpCode::SYSCALL:
+        case ir::OpCode::SYSCALL_N:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// How many operands `instr` pops, or -1 when that is only known at run time
+int pops_of(const Instruction &instr) {
+    int pops = op_info(instr.op).pops;
+    if (pops != -1) return pops;
+    uint8_t num_args = instr.op == ir::OpCode::SYSCALL     ? (uint8_t)instr.operand
+                       : instr.op == ir::OpCode::SYSCALL_N ? (uint8_t)(instr.operand >> 16)
+                                                           : (uint8_t)(instr.operand >> 32);
+    return num_args & 0x80 ? -1 : num_args;
+}
+
+// The instruction that pops the value pushed at `index`, or -1 when it is not consumed within the block
+int consumer_of(const std::vector<Instruction> &code, size_t index) {
+    int above = 0;  // Operands pushed on top of the value
+    for (size_t i = index + 1; i < code.size(); ++i) {
+        int pops = pops_of(code[i]);
+        int pushes = op_info(code[i].op).pushes;
+        if (pops == -1 || pushes == -1) return -1;
+        if (pops > above) {
+            // Only STORE_PTR_OFFSET cares which of its operands it is; mark the pointer by its position
+            return code[i].op == ir::OpCode::STORE_PTR_OFFSET && above != 0 ? -1 : (int)i;
+        }
+        above += pushes - pops;
+    }
+    return -1;
+}
+
+// Whether the value LOAD_VAR pushes at `index` is consumed by an instruction that only reads it, before anything
+// could change the slot it came from
+bool can_borrow(const std::vector<Instruction> &code, size_t index) {
+    int consumer = consumer_of(code, index);
+    if (consumer == -1 || !reads_operands(code[consumer])) return false;
+    uint16_t slot = slot_of(code[index]);
+    for (int i = (int)index + 1; i < consumer; ++i) {
+        if ((code[i].op == ir::OpCode::STORE_VAR || code[i].op == ir::OpCode::LOAD_VAR_MOVE) &&
+            slot_of(code[i]) == slot) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether the last read of a local at `index` may take the slot's reference. INDEX_ADDR leaves an address into the
+// aggregate that is only valid while something else keeps it alive.
+bool can_move(const std::vector<Instruction> &code, size_t index) {
+    int consumer = consumer_of(code, index);
+    return consumer != -1 && code[consumer].op != ir::OpCode::INDEX_ADDR;
+}
+
+}  // namespace
+
+bool LoadOwnership::run(FunctionCFG &cfg) {
+    if (cfg.num_slots == 0) return false;
+    auto live_out = slot_liveness(cfg);
+
+    bool changed = false;
+    for (size_t b = 0; b < cfg.blocks.size(); ++b) {
+        std::vector<bool> live = live_out[b];
+        auto &code = cfg.blocks[b].instructions;
+        for (size_t i = code.size(); i-- > 0;) {
+            if (code[i].op == ir::OpCode::LOAD_VAR) {
+                if (!live[slot_of(code[i])] && can_move(code, i)) {
+                    code[i].op = ir::OpCode::LOAD_VAR_MOVE;
+                    changed = true;
+                }
+                live[slot_of(code[i])] = true;
+            } else if (code[i].op == ir::OpCode::STORE_VAR) {
+                live[slot_of(code[i])] = false;
+            } else if (code[i].op == ir::OpCode::PUSH_VARARGS) {
+                read_varargs(cfg, live);
+            }
+        }
+        for (size_t i = 0; i < code.size(); ++i) {
+            if (code[i].op == ir::OpCode::LOAD_VAR && can_borrow(code, i)) {
+                code[i].op = ir::OpCode::LOAD_VAR_BORROW;
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+}  // namespace ether::opt
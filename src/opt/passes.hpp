@@ -0,0 +1,49 @@
+#ifndef ETHER_OPT_PASSES_HPP
+#define ETHER_OPT_PASSES_HPP
+
+#include "opt/pass_manager.hpp"
+
+namespace ether::opt {
+
+// Rewrites loads of a local that holds a copy of another local or of a constant to read the source directly.
+// Copies are tracked through each block and on into blocks whose only predecessor is their immediate dominator.
+class CopyPropagation : public Pass {
+   public:
+    const char *name() const override { return "copy-propagation"; }
+    bool run(FunctionCFG &cfg) override;
+};
+
+// Reuses the local an arithmetic expression was stored to when the same expression over the same unchanged locals
+// is computed again, over the same extended blocks as copy propagation.
+class CommonSubexpressionElimination : public Pass {
+   public:
+    const char *name() const override { return "cse"; }
+    bool run(FunctionCFG &cfg) override;
+};
+
+// Turns stores to locals that are never read again into pops, using slot liveness over the whole function.
+class DeadStoreElimination : public Pass {
+   public:
+    const char *name() const override { return "dead-store-elimination"; }
+    bool run(FunctionCFG &cfg) override;
+};
+
+// Removes unreachable blocks, jumps to the next block, and side-effect free computations whose value is popped.
+class DeadCodeElimination : public Pass {
+   public:
+    const char *name() const override { return "dce"; }
+    bool run(FunctionCFG &cfg) override;
+};
+
+// Decides who owns each value a local load pushes: the last read of a local moves the value out of its slot, and a
+// read whose value is used up before the slot can change borrows it, so neither touches the reference count. The
+// other passes do not know the rewritten loads, so this one runs last.
+class LoadOwnership : public Pass {
+   public:
+    const char *name() const override { return "load-ownership"; }
+    bool run(FunctionCFG &cfg) override;
+};
+
+}  // namespace ether::opt
+
+#endif  // ETHER_OPT_PASSES_HPP
@@ -7,6 +7,8 @@
 #include <unordered_map>
 #include <vector>
 
+#include "file_name.hpp"
+
 namespace ether::parser {
 struct IntegerLiteral;
 struct FloatLiteral;
@@ -135,18 +137,18 @@ struct DefaultIgnoreConstASTVisitor : public ConstASTVisitor {
 };
 
 struct ASTNode {
-    std::string filename;
+    FileName filename;
     int line;
     int column;
     int length;
-    ASTNode(std::string fn, int l, int c, int len = 1) : filename(std::move(fn)), line(l), column(c), length(len) {}
+    ASTNode(FileName fn, int l, int c, int len = 1) : filename(fn), line(l), column(c), length(len) {}
     virtual ~ASTNode() = default;
     virtual void accept(ASTVisitor& visitor) = 0;
     virtual void accept(ConstASTVisitor& visitor) const = 0;
 };
 
 struct DataType {
-    enum class Kind { I64, I32, I16, I8, F64, F32, Coroutine, Void, Ptr, String, Struct, Array };
+    enum class Kind { I64, I32, I16, I8, F64, F32, Coroutine, Void, Ptr, String, Bytes, Struct, Array };
     Kind kind;
     std::string struct_name;  // Only for Kind::Struct
     std::shared_ptr<DataType> inner;
@@ -183,6 +185,7 @@ struct DataType {
             {Kind::Void, "void"},
             {Kind::Ptr, "ptr"},
             {Kind::String, "string"},
+            {Kind::Bytes, "bytes"},
             {Kind::Struct, "struct"},
             {Kind::Array, "array "},
         };
@@ -212,16 +215,16 @@ struct DataType {
 
 struct Expression : ASTNode {
     std::unique_ptr<DataType> type;  // Assigned during semantic analysis
-    Expression(std::string fn, int l, int c, int len = 1) : ASTNode(std::move(fn), l, c, len) {}
+    Expression(FileName fn, int l, int c, int len = 1) : ASTNode(fn, l, c, len) {}
 };
 struct Statement : ASTNode {
-    Statement(std::string fn, int l, int c, int len = 1) : ASTNode(std::move(fn), l, c, len) {}
+    Statement(FileName fn, int l, int c, int len = 1) : ASTNode(fn, l, c, len) {}
 };
 
 struct IntegerLiteral : Expression {
     int64_t value;
-    IntegerLiteral(int64_t val, std::string fn, int l, int c, int len)
-        : Expression(std::move(fn), l, c, len), value(val) {}
+    IntegerLiteral(int64_t val, FileName fn, int l, int c, int len)
+        : Expression(fn, l, c, len), value(val) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
@@ -229,16 +232,16 @@ struct IntegerLiteral : Expression {
 struct FloatLiteral : Expression {
     double value;
     bool is_f32;
-    FloatLiteral(double val, bool f32, std::string fn, int l, int c, int len)
-        : Expression(std::move(fn), l, c, len), value(val), is_f32(f32) {}
+    FloatLiteral(double val, bool f32, FileName fn, int l, int c, int len)
+        : Expression(fn, l, c, len), value(val), is_f32(f32) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
 
 struct StringLiteral : Expression {
     std::string value;
-    StringLiteral(std::string v, std::string fn, int l, int c, int len)
-        : Expression(std::move(fn), l, c, len), value(std::move(v)) {}
+    StringLiteral(std::string v, FileName fn, int l, int c, int len)
+        : Expression(fn, l, c, len), value(std::move(v)) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
@@ -248,8 +251,8 @@ struct VariableExpression : Expression {
     std::string decl_filename;
     int decl_line = 0;
     int decl_col = 0;
-    VariableExpression(std::string n, std::string fn, int l, int c, int len)
-        : Expression(std::move(fn), l, c, len), name(std::move(n)) {}
+    VariableExpression(std::string n, FileName fn, int l, int c, int len)
+        : Expression(fn, l, c, len), name(std::move(n)) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
@@ -262,16 +265,17 @@ struct FunctionCall : Expression {
     int decl_col = 0;
     std::vector<DataType> param_types;
     bool is_variadic = false;
+    int syscall_index = -1;  // For syscall(): the checked built-in it calls, see ir::Syscalls
     std::unique_ptr<Expression> object = nullptr;  // For method calls
-    FunctionCall(std::string n, std::vector<std::unique_ptr<Expression>> a, std::string fn, int l, int c, int len,
+    FunctionCall(std::string n, std::vector<std::unique_ptr<Expression>> a, FileName fn, int l, int c, int len,
                  std::unique_ptr<Expression> obj = nullptr)
-        : Expression(std::move(fn), l, c, len), name(std::move(n)), args(std::move(a)), object(std::move(obj)) {}
+        : Expression(fn, l, c, len), name(std::move(n)), args(std::move(a)), object(std::move(obj)) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
 
 struct VarargExpression : Expression {
-    VarargExpression(std::string fn, int l, int c, int len) : Expression(std::move(fn), l, c, len) {}
+    VarargExpression(FileName fn, int l, int c, int len) : Expression(fn, l, c, len) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
@@ -282,16 +286,16 @@ struct BinaryExpression : Expression {
     std::unique_ptr<Expression> left;
     std::unique_ptr<Expression> right;
 
-    BinaryExpression(Op o, std::unique_ptr<Expression> l, std::unique_ptr<Expression> r, std::string fn, int line,
+    BinaryExpression(Op o, std::unique_ptr<Expression> l, std::unique_ptr<Expression> r, FileName fn, int line,
                      int c, int len)
-        : Expression(std::move(fn), line, c, len), op(o), left(std::move(l)), right(std::move(r)) {}
+        : Expression(fn, line, c, len), op(o), left(std::move(l)), right(std::move(r)) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
 
 struct Block : Statement {
     std::vector<std::unique_ptr<Statement>> statements;
-    Block(std::string fn, int l, int c, int len = 1) : Statement(std::move(fn), l, c, len) {}
+    Block(FileName fn, int l, int c, int len = 1) : Statement(fn, l, c, len) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
@@ -300,9 +304,9 @@ struct IfStatement : Statement {
     std::unique_ptr<Expression> condition;
     std::unique_ptr<Block> then_branch;
     std::unique_ptr<Block> else_branch;  // optional
-    IfStatement(std::unique_ptr<Expression> cond, std::unique_ptr<Block> tb, std::unique_ptr<Block> eb, std::string fn,
+    IfStatement(std::unique_ptr<Expression> cond, std::unique_ptr<Block> tb, std::unique_ptr<Block> eb, FileName fn,
                 int l, int c, int len)
-        : Statement(std::move(fn), l, c, len),
+        : Statement(fn, l, c, len),
           condition(std::move(cond)),
           then_branch(std::move(tb)),
           else_branch(std::move(eb)) {}
@@ -312,30 +316,30 @@ struct IfStatement : Statement {
 
 struct ReturnStatement : Statement {
     std::unique_ptr<Expression> expr;
-    ReturnStatement(std::unique_ptr<Expression> e, std::string fn, int l, int c, int len)
-        : Statement(std::move(fn), l, c, len), expr(std::move(e)) {}
+    ReturnStatement(std::unique_ptr<Expression> e, FileName fn, int l, int c, int len)
+        : Statement(fn, l, c, len), expr(std::move(e)) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
 
 struct ExpressionStatement : Statement {
     std::unique_ptr<Expression> expr;
-    ExpressionStatement(std::unique_ptr<Expression> e, std::string fn, int l, int c, int len)
-        : Statement(std::move(fn), l, c, len), expr(std::move(e)) {}
+    ExpressionStatement(std::unique_ptr<Expression> e, FileName fn, int l, int c, int len)
+        : Statement(fn, l, c, len), expr(std::move(e)) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
 
 struct YieldStatement : Statement {
-    YieldStatement(std::string fn, int l, int c, int len) : Statement(std::move(fn), l, c, len) {}
+    YieldStatement(FileName fn, int l, int c, int len) : Statement(fn, l, c, len) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
 
 struct SpawnExpression : Expression {
     std::unique_ptr<FunctionCall> call;
-    SpawnExpression(std::unique_ptr<FunctionCall> c, std::string fn, int l, int c_pos, int len)
-        : Expression(std::move(fn), l, c_pos, len), call(std::move(c)) {}
+    SpawnExpression(std::unique_ptr<FunctionCall> c, FileName fn, int l, int c_pos, int len)
+        : Expression(fn, l, c_pos, len), call(std::move(c)) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
@@ -343,33 +347,33 @@ struct SpawnExpression : Expression {
 struct AssignmentExpression : Expression {
     std::unique_ptr<Expression> lvalue;
     std::unique_ptr<Expression> value;
-    AssignmentExpression(std::unique_ptr<Expression> lv, std::unique_ptr<Expression> v, std::string fn, int l, int c,
+    AssignmentExpression(std::unique_ptr<Expression> lv, std::unique_ptr<Expression> v, FileName fn, int l, int c,
                          int len)
-        : Expression(std::move(fn), l, c, len), lvalue(std::move(lv)), value(std::move(v)) {}
+        : Expression(fn, l, c, len), lvalue(std::move(lv)), value(std::move(v)) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
 
 struct IncrementExpression : Expression {
     std::unique_ptr<Expression> lvalue;
-    IncrementExpression(std::unique_ptr<Expression> lv, std::string fn, int l, int c, int len)
-        : Expression(std::move(fn), l, c, len), lvalue(std::move(lv)) {}
+    IncrementExpression(std::unique_ptr<Expression> lv, FileName fn, int l, int c, int len)
+        : Expression(fn, l, c, len), lvalue(std::move(lv)) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
 
 struct DecrementExpression : Expression {
     std::unique_ptr<Expression> lvalue;
-    DecrementExpression(std::unique_ptr<Expression> lv, std::string fn, int l, int c, int len)
-        : Expression(std::move(fn), l, c, len), lvalue(std::move(lv)) {}
+    DecrementExpression(std::unique_ptr<Expression> lv, FileName fn, int l, int c, int len)
+        : Expression(fn, l, c, len), lvalue(std::move(lv)) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
 
 struct AwaitExpression : Expression {
     std::unique_ptr<Expression> expr;
-    AwaitExpression(std::unique_ptr<Expression> e, std::string fn, int l, int c, int len)
-        : Expression(std::move(fn), l, c, len), expr(std::move(e)) {}
+    AwaitExpression(std::unique_ptr<Expression> e, FileName fn, int l, int c, int len)
+        : Expression(fn, l, c, len), expr(std::move(e)) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
@@ -379,8 +383,8 @@ struct SizeofExpression : Expression {
     uint32_t calculated_size = 0;
     int type_line;
     int type_col;
-    SizeofExpression(DataType t, int tl, int tc, std::string fn, int l, int c, int len)
-        : Expression(std::move(fn), l, c, len), target_type(t), type_line(tl), type_col(tc) {}
+    SizeofExpression(DataType t, int tl, int tc, FileName fn, int l, int c, int len)
+        : Expression(fn, l, c, len), target_type(t), type_line(tl), type_col(tc) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
@@ -388,8 +392,8 @@ struct SizeofExpression : Expression {
 struct MemberAccessExpression : Expression {
     std::unique_ptr<Expression> object;
     std::string member_name;
-    MemberAccessExpression(std::unique_ptr<Expression> obj, std::string mem, std::string fn, int l, int c, int len)
-        : Expression(std::move(fn), l, c, len), object(std::move(obj)), member_name(std::move(mem)) {}
+    MemberAccessExpression(std::unique_ptr<Expression> obj, std::string mem, FileName fn, int l, int c, int len)
+        : Expression(fn, l, c, len), object(std::move(obj)), member_name(std::move(mem)) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
@@ -397,9 +401,9 @@ struct MemberAccessExpression : Expression {
 struct IndexExpression : Expression {
     std::unique_ptr<Expression> object;
     std::unique_ptr<Expression> index;
-    IndexExpression(std::unique_ptr<Expression> obj, std::unique_ptr<Expression> idx, std::string fn, int l, int c,
+    IndexExpression(std::unique_ptr<Expression> obj, std::unique_ptr<Expression> idx, FileName fn, int l, int c,
                     int len)
-        : Expression(std::move(fn), l, c, len), object(std::move(obj)), index(std::move(idx)) {}
+        : Expression(fn, l, c, len), object(std::move(obj)), index(std::move(idx)) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
@@ -410,8 +414,8 @@ struct ForStatement : Statement {
     std::unique_ptr<Expression> increment;
     std::unique_ptr<Block> body;
     ForStatement(std::unique_ptr<Statement> i, std::unique_ptr<Expression> c, std::unique_ptr<Expression> inc,
-                 std::unique_ptr<Block> b, std::string fn, int l, int c_pos, int len)
-        : Statement(std::move(fn), l, c_pos, len),
+                 std::unique_ptr<Block> b, FileName fn, int l, int c_pos, int len)
+        : Statement(fn, l, c_pos, len),
           init(std::move(i)),
           condition(std::move(c)),
           increment(std::move(inc)),
@@ -426,9 +430,9 @@ struct VariableDeclaration : Statement {
     int name_line;
     int name_col;
     std::unique_ptr<Expression> init;
-    VariableDeclaration(DataType t, std::string n, int nl, int nc, std::unique_ptr<Expression> i, std::string fn, int l,
+    VariableDeclaration(DataType t, std::string n, int nl, int nc, std::unique_ptr<Expression> i, FileName fn, int l,
                         int c, int len)
-        : Statement(std::move(fn), l, c, len),
+        : Statement(fn, l, c, len),
           type(t),
           name(std::move(n)),
           name_line(nl),
@@ -457,8 +461,8 @@ struct Function : Expression {
     std::unique_ptr<Block> body;
     std::string struct_name;  // For methods
     Function(DataType rt, std::string n, int nl, int nc, std::vector<Parameter> p, bool variadic,
-             std::unique_ptr<Block> b, std::string fn, int l, int c, int len, std::string sn = "")
-        : Expression(std::move(fn), l, c, len),
+             std::unique_ptr<Block> b, FileName fn, int l, int c, int len, std::string sn = "")
+        : Expression(fn, l, c, len),
           return_type(rt),
           name(std::move(n)),
           name_line(nl),
@@ -473,8 +477,11 @@ struct Function : Expression {
 
 struct Include : ASTNode {
     std::string path;
-    Include(std::string p, std::string fn, int l, int c, int len)
-        : ASTNode(std::move(fn), l, c, len), path(std::move(p)) {}
+    // Set when the path did not exist next to the including file and was resolved against the working directory
+    // instead: the file that was looked for first
+    std::string shadowed_path;
+    Include(std::string p, FileName fn, int l, int c, int len, std::string shadowed = "")
+        : ASTNode(fn, l, c, len), path(std::move(p)), shadowed_path(std::move(shadowed)) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
@@ -484,8 +491,8 @@ struct StructDeclaration : ASTNode {
     int name_line;
     int name_col;
     std::vector<Parameter> members;
-    StructDeclaration(std::string n, int nl, int nc, std::vector<Parameter> m, std::string fn, int l, int c, int len)
-        : ASTNode(std::move(fn), l, c, len), name(std::move(n)), name_line(nl), name_col(nc), members(std::move(m)) {}
+    StructDeclaration(std::string n, int nl, int nc, std::vector<Parameter> m, FileName fn, int l, int c, int len)
+        : ASTNode(fn, l, c, len), name(std::move(n)), name_line(nl), name_col(nc), members(std::move(m)) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
@@ -494,8 +501,8 @@ struct EnumAccessExpression : Expression {
     std::string enum_name;
     std::string member_name;
     int64_t value = 0;
-    EnumAccessExpression(std::string en, std::string mem, std::string fn, int l, int c, int len)
-        : Expression(std::move(fn), l, c, len), enum_name(std::move(en)), member_name(std::move(mem)) {}
+    EnumAccessExpression(std::string en, std::string mem, FileName fn, int l, int c, int len)
+        : Expression(fn, l, c, len), enum_name(std::move(en)), member_name(std::move(mem)) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
@@ -510,8 +517,8 @@ struct EnumMember {
 struct EnumDeclaration : ASTNode {
     std::string name;
     std::vector<EnumMember> members;
-    EnumDeclaration(std::string n, int nl, int nc, std::vector<EnumMember> m, std::string fn, int l, int c, int len)
-        : ASTNode(std::move(fn), l, c, len), name(std::move(n)), members(std::move(m)) {
+    EnumDeclaration(std::string n, int nl, int nc, std::vector<EnumMember> m, FileName fn, int l, int c, int len)
+        : ASTNode(fn, l, c, len), name(std::move(n)), members(std::move(m)) {
         name_line = nl;
         name_col = nc;
     }
@@ -527,7 +534,7 @@ struct Program : ASTNode {
     std::vector<std::unique_ptr<EnumDeclaration>> enums;
     std::vector<std::unique_ptr<VariableDeclaration>> globals;
     std::vector<std::unique_ptr<Function>> functions;
-    Program() : ASTNode("", 0, 0) {}
+    Program() : ASTNode(FileName(), 0, 0) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
     void accept(ConstASTVisitor& visitor) const override { visitor.visit(*this); }
 };
@@ -0,0 +1,242 @@
+#include "ast_cache.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <string_view>
+#include <system_error>
+
+namespace ether::parser {
+
+namespace {
+
+class Cloner : public ConstASTVisitor {
+   public:
+    template <typename T>
+    std::unique_ptr<T> clone(const T *node) {
+        if (!node) return nullptr;
+        node->accept(*this);
+        return std::unique_ptr<T>(static_cast<T *>(m_result.release()));
+    }
+    template <typename T>
+    std::vector<std::unique_ptr<T>> clone_all(const std::vector<std::unique_ptr<T>> &nodes) {
+        std::vector<std::unique_ptr<T>> copies;
+        copies.reserve(nodes.size());
+        for (const auto &node : nodes) copies.push_back(clone(node.get()));
+        return copies;
+    }
+
+    void visit(const IntegerLiteral &node) override {
+        m_result = std::make_unique<IntegerLiteral>(node.value, node.filename, node.line, node.column, node.length);
+    }
+    void visit(const FloatLiteral &node) override {
+        m_result = std::make_unique<FloatLiteral>(node.value, node.is_f32, node.filename, node.line, node.column,
+                                                  node.length);
+    }
+    void visit(const StringLiteral &node) override {
+        m_result = std::make_unique<StringLiteral>(node.value, node.filename, node.line, node.column, node.length);
+    }
+    void visit(const VariableExpression &node) override {
+        m_result = std::make_unique<VariableExpression>(node.name, node.filename, node.line, node.column, node.length);
+    }
+    void visit(const FunctionCall &node) override {
+        auto args = clone_all(node.args);
+        auto object = clone(node.object.get());
+        m_result = std::make_unique<FunctionCall>(node.name, std::move(args), node.filename, node.line, node.column,
+                                                  node.length, std::move(object));
+    }
+    void visit(const VarargExpression &node) override {
+        m_result = std::make_unique<VarargExpression>(node.filename, node.line, node.column, node.length);
+    }
+    void visit(const BinaryExpression &node) override {
+        auto left = clone(node.left.get());
+        auto right = clone(node.right.get());
+        m_result = std::make_unique<BinaryExpression>(node.op, std::move(left), std::move(right), node.filename,
+                                                      node.line, node.column, node.length);
+    }
+    void visit(const Block &node) override {
+        auto block = std::make_unique<Block>(node.filename, node.line, node.column, node.length);
+        block->statements = clone_all(node.statements);
+        m_result = std::move(block);
+    }
+    void visit(const IfStatement &node) override {
+        auto condition = clone(node.condition.get());
+        auto then_branch = clone(node.then_branch.get());
+        auto else_branch = clone(node.else_branch.get());
+        m_result = std::make_unique<IfStatement>(std::move(condition), std::move(then_branch), std::move(else_branch),
+                                                 node.filename, node.line, node.column, node.length);
+    }
+    void visit(const ReturnStatement &node) override {
+        auto expr = clone(node.expr.get());
+        m_result = std::make_unique<ReturnStatement>(std::move(expr), node.filename, node.line, node.column,
+                                                     node.length);
+    }
+    void visit(const ExpressionStatement &node) override {
+        auto expr = clone(node.expr.get());
+        m_result = std::make_unique<ExpressionStatement>(std::move(expr), node.filename, node.line, node.column,
+                                                         node.length);
+    }
+    void visit(const YieldStatement &node) override {
+        m_result = std::make_unique<YieldStatement>(node.filename, node.line, node.column, node.length);
+    }
+    void visit(const SpawnExpression &node) override {
+        auto call = clone(node.call.get());
+        m_result = std::make_unique<SpawnExpression>(std::move(call), node.filename, node.line, node.column,
+                                                     node.length);
+    }
+    void visit(const AssignmentExpression &node) override {
+        auto lvalue = clone(node.lvalue.get());
+        auto value = clone(node.value.get());
+        m_result = std::make_unique<AssignmentExpression>(std::move(lvalue), std::move(value), node.filename,
+                                                          node.line, node.column, node.length);
+    }
+    void visit(const IncrementExpression &node) override {
+        auto lvalue = clone(node.lvalue.get());
+        m_result = std::make_unique<IncrementExpression>(std::move(lvalue), node.filename, node.line, node.column,
+                                                         node.length);
+    }
+    void visit(const DecrementExpression &node) override {
+        auto lvalue = clone(node.lvalue.get());
+        m_result = std::make_unique<DecrementExpression>(std::move(lvalue), node.filename, node.line, node.column,
+                                                         node.length);
+    }
+    void visit(const AwaitExpression &node) override {
+        auto expr = clone(node.expr.get());
+        m_result = std::make_unique<AwaitExpression>(std::move(expr), node.filename, node.line, node.column,
+                                                     node.length);
+    }
+    void visit(const ForStatement &node) override {
+        auto init = clone(node.init.get());
+        auto condition = clone(node.condition.get());
+        auto increment = clone(node.increment.get());
+        auto body = clone(node.body.get());
+        m_result = std::make_unique<ForStatement>(std::move(init), std::move(condition), std::move(increment),
+                                                  std::move(body), node.filename, node.line, node.column, node.length);
+    }
+    void visit(const VariableDeclaration &node) override {
+        auto init = clone(node.init.get());
+        m_result = std::make_unique<VariableDeclaration>(node.type, node.name, node.name_line, node.name_col,
+                                                         std::move(init), node.filename, node.line, node.column,
+                                                         node.length);
+    }
+    void visit(const Function &node) override {
+        auto body = clone(node.body.get());
+        m_result = std::make_unique<Function>(node.return_type, node.name, node.name_line, node.name_col, node.params,
+                                              node.is_variadic, std::move(body), node.filename, node.line,
+                                              node.column, node.length, node.struct_name);
+    }
+    void visit(const Include &node) override {
+        m_result = std::make_unique<Include>(node.path, node.filename, node.line, node.column, node.length,
+                                             node.shadowed_path);
+    }
+    void visit(const StructDeclaration &node) override {
+        m_result = std::make_unique<StructDeclaration>(node.name, node.name_line, node.name_col, node.members,
+                                                       node.filename, node.line, node.column, node.length);
+    }
+    void visit(const EnumDeclaration &node) override {
+        m_result = std::make_unique<EnumDeclaration>(node.name, node.name_line, node.name_col, node.members,
+                                                     node.filename, node.line, node.column, node.length);
+    }
+    void visit(const EnumAccessExpression &node) override {
+        m_result = std::make_unique<EnumAccessExpression>(node.enum_name, node.member_name, node.filename, node.line,
+                                                          node.column, node.length);
+    }
+    void visit(const MemberAccessExpression &node) override {
+        auto object = clone(node.object.get());
+        m_result = std::make_unique<MemberAccessExpression>(std::move(object), node.member_name, node.filename,
+                                                            node.line, node.column, node.length);
+    }
+    void visit(const IndexExpression &node) override {
+        auto object = clone(node.object.get());
+        auto index = clone(node.index.get());
+        m_result = std::make_unique<IndexExpression>(std::move(object), std::move(index), node.filename, node.line,
+                                                     node.column, node.length);
+    }
+    void visit(const SizeofExpression &node) override {
+        m_result = std::make_unique<SizeofExpression>(node.target_type, node.type_line, node.type_col, node.filename,
+                                                      node.line, node.column, node.length);
+    }
+    void visit(const Program &node) override {
+        auto program = std::make_unique<Program>();
+        program->filename = node.filename;
+        program->includes = clone_all(node.includes);
+        program->structs = clone_all(node.structs);
+        program->enums = clone_all(node.enums);
+        program->globals = clone_all(node.globals);
+        program->functions = clone_all(node.functions);
+        m_result = std::move(program);
+    }
+
+   private:
+    std::unique_ptr<ASTNode> m_result;
+};
+
+ParsedFile copy_of(const ParsedFile &file) {
+    ParsedFile copy;
+    if (file.program) copy.program = clone_program(*file.program);
+    copy.sites = file.sites;
+    copy.error = file.error;
+    copy.unreadable = file.unreadable;
+    return copy;
+}
+
+}  // namespace
+
+std::unique_ptr<Program> clone_program(const Program &program) {
+    Cloner cloner;
+    return cloner.clone(&program);
+}
+
+ParsedFile AstCache::load(const std::string &path) {
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    uintmax_t size = ec ? 0 : std::filesystem::file_size(path, ec);
+    if (ec) return parse_file(path);
+
+    std::shared_ptr<const ParsedFile> cached;
+    {
+        std::lock_guard lock(m_mutex);
+        auto it = m_entries.find(path);
+        if (it != m_entries.end()) {
+            if (it->second.mtime == mtime && it->second.size == size) return copy_of(*it->second.parsed);
+            cached = it->second.parsed;
+        }
+    }
+
+    std::ifstream in(path);
+    if (!in.is_open()) return parse_file(path);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string source = buffer.str();
+    size_t hash = std::hash<std::string_view>{}(source);
+
+    {
+        std::lock_guard lock(m_mutex);
+        auto it = m_entries.find(path);
+        if (cached && it != m_entries.end() && it->second.parsed == cached && it->second.hash == hash) {
+            // Touched but not edited
+            it->second.mtime = mtime;
+            it->second.size = size;
+            return copy_of(*cached);
+        }
+    }
+
+    ParsedFile parsed = parse_source(source, path);
+    // Failures are not kept: the file is most likely being edited
+    if (parsed.error) return parsed;
+    auto entry = std::make_shared<const ParsedFile>(copy_of(parsed));
+    std::lock_guard lock(m_mutex);
+    m_entries[path] = {mtime, size, hash, std::move(entry)};
+    return parsed;
+}
+
+size_t AstCache::size() const {
+    std::lock_guard lock(m_mutex);
+    return m_entries.size();
+}
+
+void AstCache::clear() {
+    std::lock_guard lock(m_mutex);
+    m_entries.clear();
+}
+
+}  // namespace ether::parser
@@ -0,0 +1,44 @@
+#ifndef ETHER_PARSER_AST_CACHE_HPP
+#define ETHER_PARSER_AST_CACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "include_graph.hpp"
+
+namespace ether::parser {
+
+// Included files parsed by earlier compilations in the same process, for the front end's long-lived users: the
+// language server and the embedding Engine. An entry is reused while the file keeps its size and modification time,
+// or, when those changed, while its content hashes the same; so a refresh only re-parses the files that changed.
+// The analyzer and the constant folder annotate and rewrite the trees they are given, so every load hands out a
+// fresh copy and the cached tree itself is never touched.
+class AstCache {
+   public:
+    // Same as parse_file(path), from the cache when possible. Safe to call from several threads.
+    ParsedFile load(const std::string &path);
+
+    size_t size() const;
+    void clear();
+
+   private:
+    struct Entry {
+        std::filesystem::file_time_type mtime;
+        uintmax_t size;
+        size_t hash;
+        std::shared_ptr<const ParsedFile> parsed;
+    };
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_entries;
+};
+
+// A deep copy of the tree as the parser built it, leaving out everything later passes fill in
+std::unique_ptr<Program> clone_program(const Program &program);
+
+}  // namespace ether::parser
+
+#endif  // ETHER_PARSER_AST_CACHE_HPP
@@ -0,0 +1,24 @@
+#include "file_name.hpp"
+
+#include <mutex>
+#include <unordered_set>
+
+namespace ether::parser {
+
+// Files are named once per parse, from any of the include parser's threads, so a lock is cheap enough. Elements of
+// an unordered_set never move, which keeps the handed out pointers valid.
+static const std::string *intern(const std::string &name) {
+    static std::mutex mutex;
+    static std::unordered_set<std::string> names;
+    std::lock_guard lock(mutex);
+    return &*names.insert(name).first;
+}
+
+FileName::FileName() {
+    static const std::string *empty = intern("");
+    m_name = empty;
+}
+
+FileName::FileName(const std::string &name) : m_name(intern(name)) {}
+
+}  // namespace ether::parser
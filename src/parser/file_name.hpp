@@ -0,0 +1,31 @@
+#ifndef ETHER_PARSER_FILE_NAME_HPP
+#define ETHER_PARSER_FILE_NAME_HPP
+
+#include <ostream>
+#include <string>
+
+namespace ether::parser {
+
+// The name of a source file, interned: every node of a file points at one shared copy of the name rather than
+// carrying a string of its own. Interned names live until the process exits, and two FileNames are equal exactly
+// when they point at the same copy. Converts to the name wherever a std::string is expected.
+class FileName {
+   public:
+    FileName();
+    FileName(const std::string &name);
+
+    const std::string &str() const { return *m_name; }
+    operator const std::string &() const { return *m_name; }
+    bool empty() const { return m_name->empty(); }
+
+    friend bool operator==(FileName a, FileName b) { return a.m_name == b.m_name; }
+    friend bool operator==(FileName a, const std::string &b) { return *a.m_name == b; }
+    friend std::ostream &operator<<(std::ostream &out, FileName name) { return out << *name.m_name; }
+
+   private:
+    const std::string *m_name;
+};
+
+}  // namespace ether::parser
+
+#endif  // ETHER_PARSER_FILE_NAME_HPP
@@ -0,0 +1,176 @@
+#include "include_graph.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "ast_cache.hpp"
+#include "common/error.hpp"
+#include "lexer/lexer.hpp"
+
+namespace ether::parser {
+
+static ParsedFile parse_tokens(const std::vector<lexer::Token> &tokens, const std::string &path) {
+    ParsedFile file;
+    Parser parser(tokens, path);
+    try {
+        file.program = parser.parse_program();
+    } catch (...) {
+        file.error = std::current_exception();
+    }
+    file.sites = parser.include_sites();
+    return file;
+}
+
+ParsedFile parse_source(const std::string &source, const std::string &path) {
+    std::vector<lexer::Token> tokens;
+    try {
+        lexer::Lexer lexer(source, path);
+        tokens = lexer.tokenize();
+    } catch (...) {
+        ParsedFile file;
+        file.error = std::current_exception();
+        return file;
+    }
+    return parse_tokens(tokens, path);
+}
+
+ParsedFile parse_file(const std::string &path) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        ParsedFile file;
+        file.unreadable = true;
+        return file;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    return parse_source(buffer.str(), path);
+}
+
+namespace {
+
+// Parses every file reachable through the include sites it is given, each once. Worker threads are started as
+// files queue up, up to one per core; the calling thread works too.
+class IncludeParser {
+   public:
+    IncludeParser(const std::string &root, AstCache *cache)
+        : m_cache(cache), m_max_workers(std::max(1u, std::thread::hardware_concurrency())) {
+        m_files.try_emplace(root);
+    }
+
+    void run(const std::vector<IncludeSite> &sites) {
+        {
+            std::lock_guard lock(m_mutex);
+            queue(sites);
+        }
+        work();
+        // Nothing is queued or being parsed any more, so no worker can be started past this point
+        for (auto &worker : m_workers) worker.join();
+    }
+
+    ParsedFile &file(const std::string &path) { return m_files.at(path); }
+
+   private:
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::unordered_map<std::string, ParsedFile> m_files;  // Every file seen, parsed or not yet
+    std::vector<std::string> m_queue;
+    size_t m_busy = 0;
+    std::vector<std::thread> m_workers;
+    AstCache *m_cache;
+    unsigned m_max_workers;
+
+    // Called with m_mutex held
+    void queue(const std::vector<IncludeSite> &sites) {
+        for (const auto &site : sites) {
+            if (m_files.try_emplace(site.path).second) m_queue.push_back(site.path);
+        }
+        while (m_workers.size() + 1 < m_max_workers && m_workers.size() + 1 < m_queue.size() + m_busy) {
+            m_workers.emplace_back([this] { work(); });
+        }
+    }
+
+    void work() {
+        std::unique_lock lock(m_mutex);
+        while (true) {
+            // With nothing queued and no file being parsed, no more files can turn up
+            m_changed.wait(lock, [&] { return !m_queue.empty() || m_busy == 0; });
+            if (m_queue.empty()) return;
+            std::string path = std::move(m_queue.back());
+            m_queue.pop_back();
+            m_busy++;
+            lock.unlock();
+            ParsedFile parsed = m_cache ? m_cache->load(path) : parse_file(path);
+            lock.lock();
+            m_busy--;
+            queue(parsed.sites);
+            m_files[path] = std::move(parsed);
+            m_changed.notify_all();
+        }
+    }
+};
+
+// Moves declarations of `from` up to the counts of `until` into `out`, starting where `at` was left
+void take(Program &from, IncludeSite &at, const IncludeSite &until, Program &out) {
+    auto move_range = [](auto &src, size_t &next, size_t end, auto &dst) {
+        for (; next < end; ++next) dst.push_back(std::move(src[next]));
+    };
+    move_range(from.includes, at.includes, until.includes, out.includes);
+    move_range(from.structs, at.structs, until.structs, out.structs);
+    move_range(from.enums, at.enums, until.enums, out.enums);
+    move_range(from.globals, at.globals, until.globals, out.globals);
+    move_range(from.functions, at.functions, until.functions, out.functions);
+}
+
+// Appends `file` to `out`, expanding its includes in place. Walks the graph in the order a serial parse would have
+// visited it, so the same error comes out first.
+void splice(IncludeParser &files, std::unordered_set<std::string> &merged, ParsedFile &file, const std::string &path,
+            Program &out) {
+    IncludeSite at{};
+    for (const auto &site : file.sites) {
+        if (file.program) take(*file.program, at, site, out);
+        if (!merged.insert(site.path).second) continue;
+        ParsedFile &included = files.file(site.path);
+        if (included.unreadable) {
+            throw CompilerError("Could not open included file: " + site.path, path, site.line, site.column,
+                                site.length);
+        }
+        splice(files, merged, included, site.path, out);
+    }
+    if (file.error) std::rethrow_exception(file.error);
+
+    Program &program = *file.program;
+    IncludeSite end{"", 0, 0, 0, program.includes.size(), program.structs.size(), program.enums.size(),
+                    program.globals.size(), program.functions.size()};
+    take(program, at, end, out);
+}
+
+}  // namespace
+
+std::unique_ptr<Program> parse_with_includes(const std::vector<lexer::Token> &tokens, const std::string &filename,
+                                             AstCache *cache) {
+    ParsedFile root = parse_tokens(tokens, filename);
+    if (root.sites.empty()) {
+        if (root.error) std::rethrow_exception(root.error);
+        return std::move(root.program);
+    }
+
+    std::string root_path = std::filesystem::weakly_canonical(filename).string();
+    IncludeParser files(root_path, cache);
+    files.run(root.sites);
+
+    auto program = std::make_unique<Program>();
+    program->filename = filename;
+    std::unordered_set<std::string> merged{root_path};
+    splice(files, merged, root, filename, *program);
+    return program;
+}
+
+}  // namespace ether::parser
@@ -0,0 +1,37 @@
+#ifndef ETHER_PARSER_INCLUDE_GRAPH_HPP
+#define ETHER_PARSER_INCLUDE_GRAPH_HPP
+
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ast.hpp"
+#include "lexer/token.hpp"
+#include "parser.hpp"
+
+namespace ether::parser {
+
+class AstCache;
+
+// One file on its own, with its includes left unexpanded
+struct ParsedFile {
+    std::unique_ptr<Program> program;  // Null when parsing failed
+    std::vector<IncludeSite> sites;    // Those before the error, if any
+    std::exception_ptr error;
+    bool unreadable = false;
+};
+
+ParsedFile parse_source(const std::string &source, const std::string &path);
+ParsedFile parse_file(const std::string &path);
+
+// Parses a file together with everything it includes. Included files are read, lexed and parsed on a pool of threads
+// as the include graph is discovered, then spliced in at their #include as if it had been expanded in place. Each
+// file is included once, at its first #include; later ones, through whatever relative path or symlink, add nothing.
+// Errors are the ones a serial parse would report first. Included files come from `cache` when it has them.
+std::unique_ptr<Program> parse_with_includes(const std::vector<lexer::Token> &tokens, const std::string &filename,
+                                             AstCache *cache = nullptr);
+
+}  // namespace ether::parser
+
+#endif  // ETHER_PARSER_INCLUDE_GRAPH_HPP
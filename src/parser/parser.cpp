@@ -1,10 +1,8 @@
 #include "parser.hpp"
 
 #include <filesystem>
-#include <fstream>
 #include <iostream>
 #include <memory>
-#include <sstream>
 #include <string>
 #include <vector>
 
@@ -45,7 +43,7 @@ DataType Parser::parse_type() {
                                 (int)err_token.lexeme.size());
         }
         const auto &size_token = advance();
-        uint32_t array_size = std::stoul(std::string(size_token.lexeme));
+        uint32_t array_size = (uint32_t)lexer::integer_value(size_token.lexeme);
         if (!match(lexer::TokenType::RBracket)) {
             const auto &err_token = peek();
             throw CompilerError("Expected ']' after array size", m_filename, err_token.line, err_token.column,
@@ -74,6 +72,8 @@ DataType Parser::parse_type() {
         kind = DataType::Kind::Ptr;
     else if (match(lexer::TokenType::String))
         kind = DataType::Kind::String;
+    else if (match(lexer::TokenType::Bytes))
+        kind = DataType::Kind::Bytes;
     else if (match(lexer::TokenType::Void))
         kind = DataType::Kind::Void;
     else if (match(lexer::TokenType::Struct)) {
@@ -122,40 +122,27 @@ void Parser::parse_top_level(Program &program) {
                                 (int)token.lexeme.size());
         }
         const auto &path_token = m_tokens[m_pos - 1];
-        std::string path(path_token.lexeme);
+        std::string path = lexer::unescape(path_token.lexeme);
 
         // Resolve path relative to m_filename
-        fs::path current_dir = fs::path(m_filename).parent_path();
+        fs::path current_dir = fs::path(m_filename.str()).parent_path();
         fs::path absolute_path = current_dir / path;
+        std::string shadowed_path;
         if (!fs::exists(absolute_path)) {
             // Fallback to working directory relative
+            shadowed_path = fs::absolute(absolute_path).lexically_normal().string();
             absolute_path = fs::absolute(path);
         }
-        std::string resolved_path = absolute_path.lexically_normal().string();
+        // Canonical, so every spelling of the same file is included once
+        std::string resolved_path = fs::weakly_canonical(absolute_path).string();
 
         int len = (int)(path_token.column - include_token.column) + (int)path_token.lexeme.size();
         program.includes.push_back(
-            std::make_unique<Include>(resolved_path, m_filename, include_token.line, include_token.column, len));
-
-        // Recursive parse
-        std::ifstream file(resolved_path);
-        if (!file.is_open()) {
-            throw CompilerError("Could not open included file: " + resolved_path, m_filename, path_token.line,
-                                path_token.column, (int)path_token.lexeme.size());
-        }
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        std::string included_source = buffer.str();
-        lexer::Lexer imported_lexer(included_source, resolved_path);
-        auto imported_tokens = imported_lexer.tokenize();
-        Parser imported_parser(imported_tokens, resolved_path);
-        auto sub_program = imported_parser.parse_program();
-        // Merge sub_program into current program
-        for (auto &inc : sub_program->includes) program.includes.push_back(std::move(inc));
-        for (auto &str : sub_program->structs) program.structs.push_back(std::move(str));
-        for (auto &en : sub_program->enums) program.enums.push_back(std::move(en));
-        for (auto &glob : sub_program->globals) program.globals.push_back(std::move(glob));
-        for (auto &func : sub_program->functions) program.functions.push_back(std::move(func));
+            std::make_unique<Include>(resolved_path, m_filename, include_token.line, include_token.column, len,
+                                      std::move(shadowed_path)));
+        m_include_sites.push_back({resolved_path, path_token.line, path_token.column, (int)path_token.lexeme.size(),
+                                   program.includes.size(), program.structs.size(), program.enums.size(),
+                                   program.globals.size(), program.functions.size()});
         return;
     }
 
@@ -181,7 +168,7 @@ void Parser::parse_top_level(Program &program) {
         throw CompilerError("Expected name after type", m_filename, token.line, token.column, (int)token.lexeme.size());
     }
     const auto &name_token = advance();
-    auto name = name_token.lexeme;
+    std::string name(name_token.lexeme);
     std::string struct_name = "";
     int method_name_line = name_token.line;
     int method_name_col = name_token.column;
@@ -289,7 +276,7 @@ std::unique_ptr<EnumDeclaration> Parser::parse_enum_declaration() {
                                 (int)tok.lexeme.size());
         }
         const auto &val_token = advance();
-        int64_t value = std::stoll(std::string(val_token.lexeme));
+        int64_t value = lexer::integer_value(val_token.lexeme);
         members.push_back({std::move(mem_name), value, mem_tok.line, mem_tok.column});
         if (match(lexer::TokenType::Comma)) {
             continue;
@@ -314,7 +301,7 @@ std::unique_ptr<Function> Parser::parse_function() {
         throw CompilerError("Expected function name", m_filename, token.line, token.column, (int)token.lexeme.size());
     }
     const auto &name_token = advance();
-    auto name = name_token.lexeme;
+    std::string name(name_token.lexeme);
     std::string struct_name = "";
 
     if (match(lexer::TokenType::ColonColon)) {
@@ -446,7 +433,8 @@ std::unique_ptr<Statement> Parser::parse_statement() {
     if (check(lexer::TokenType::I64) || check(lexer::TokenType::I32) || check(lexer::TokenType::I16) ||
         check(lexer::TokenType::I8) || check(lexer::TokenType::F64) || check(lexer::TokenType::F32) ||
         check(lexer::TokenType::Coroutine) || check(lexer::TokenType::Ptr) || check(lexer::TokenType::Void) ||
-        check(lexer::TokenType::String) || check(lexer::TokenType::Struct) || check(lexer::TokenType::LBracket) ||
+        check(lexer::TokenType::String) || check(lexer::TokenType::Bytes) || check(lexer::TokenType::Struct) ||
+        check(lexer::TokenType::LBracket) ||
         (check(lexer::TokenType::Identifier) && m_pos + 1 < m_tokens.size() &&
          m_tokens[m_pos + 1].type == lexer::TokenType::Identifier)) {
         DataType type = parse_type();
@@ -456,7 +444,7 @@ std::unique_ptr<Statement> Parser::parse_statement() {
                                 (int)token.lexeme.size());
         }
         const auto &name_token = advance();
-        auto name = name_token.lexeme;
+        std::string name(name_token.lexeme);
         std::unique_ptr<Expression> init = nullptr;
         if (match(lexer::TokenType::Equal)) {
             init = parse_expression();
@@ -669,7 +657,7 @@ std::unique_ptr<Expression> Parser::parse_primary() {
     }
     if (match(lexer::TokenType::IntegerLiteral)) {
         const auto &tok = m_tokens[m_pos - 1];
-        int64_t val = std::stoll(std::string(tok.lexeme));
+        int64_t val = lexer::integer_value(tok.lexeme);
         return std::make_unique<IntegerLiteral>(val, m_filename, token.line, token.column, (int)tok.lexeme.size());
     }
     if (match(lexer::TokenType::FloatLiteral)) {
@@ -682,7 +670,7 @@ std::unique_ptr<Expression> Parser::parse_primary() {
     }
     if (match(lexer::TokenType::StringLiteral)) {
         const auto &tok = m_tokens[m_pos - 1];
-        return std::make_unique<StringLiteral>(std::string(tok.lexeme), m_filename, token.line, token.column,
+        return std::make_unique<StringLiteral>(lexer::unescape(tok.lexeme), m_filename, token.line, token.column,
                                                (int)tok.lexeme.size());
     }
     if (match(lexer::TokenType::Identifier)) {
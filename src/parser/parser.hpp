@@ -10,15 +10,32 @@
 
 namespace ether::parser {
 
+// Where an #include appeared in the file, and how many declarations of each kind came before it. The parser does
+// not read included files itself; parse_with_includes() splices them in at these points.
+struct IncludeSite {
+    std::string path;  // Resolved
+    int line;          // Of the path literal
+    int column;
+    int length;
+    size_t includes;  // Including the site's own Include node
+    size_t structs;
+    size_t enums;
+    size_t globals;
+    size_t functions;
+};
+
 class Parser {
    public:
     explicit Parser(const std::vector<lexer::Token> &tokens, std::string filename);
     std::unique_ptr<Program> parse_program();
+    // The #includes parsed so far, in source order; still valid after parse_program() throws
+    const std::vector<IncludeSite> &include_sites() const { return m_include_sites; }
 
    private:
     const std::vector<lexer::Token> &m_tokens;
-    std::string m_filename;
+    FileName m_filename;
     size_t m_pos = 0;
+    std::vector<IncludeSite> m_include_sites;
 
     const lexer::Token &peek() const;
     const lexer::Token &advance();
@@ -0,0 +1,44 @@
+#include <iostream>
+#include <string>
+
+#include "driver/vm_flags.hpp"
+#include "ir/bytecode_file.hpp"
+#include "vm/vm.hpp"
+
+// Runtime-only entry point: executes a .ethc image produced by `ether <file> --emit-bytecode`, without linking the
+// lexer, parser, analyzer or code generator.
+static void print_usage() {
+    std::cerr << "Usage: ether-run <image.ethc> [flags]\n\n"
+              << "      --output-policy <p>     When console output backs up: block (default) or drop\n"
+              << "      --output-buffer <bytes> Console output queued per stream (default 1048576)" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        print_usage();
+        return 1;
+    }
+    std::string filename = argv[1];
+    if (filename == "-h" || filename == "--help") {
+        print_usage();
+        return 0;
+    }
+
+    try {
+        ether::vm::VMOptions vm_options;
+        for (int i = 2; i < argc; ++i) {
+            if (!ether::driver::parse_vm_flag(argc, argv, i, vm_options)) {
+                throw std::runtime_error(std::string("unknown flag ") + argv[i]);
+            }
+        }
+
+        ether::ir::MappedImage image(filename);
+        ether::vm::VM vm(image.view(), vm_options);
+        ether::vm::Value result = vm.run();
+        std::cout << "VM Execution Result: " << result << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
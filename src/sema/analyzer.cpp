@@ -1,6 +1,7 @@
 #include "analyzer.hpp"
 
 #include "common/error.hpp"
+#include "ir/syscalls.hpp"
 
 namespace ether::sema {
 
@@ -298,18 +299,86 @@ void Analyzer::visit(FunctionCall &node) {
         param_idx++;
     }
 
+    std::vector<DataType> arg_types;
     for (size_t i = 0; i < node.args.size(); ++i) {
         node.args[i]->accept(*this);
+        arg_types.push_back(m_current_type);
         // Param type check if not variadic part
         if (param_idx < info.param_types.size()) {
             // check type
         }
         param_idx++;
     }
+    if (lookup_name == "syscall") check_syscall(node, arg_types);
     m_current_type = info.return_type;
     node.type = std::make_unique<DataType>(m_current_type);
 }
 
+// Checks a syscall with a constant id against the signature of the built-in it names. Calls that forward `...` are
+// only checked as far as their fixed arguments go.
+void Analyzer::check_syscall(FunctionCall &node, const std::vector<DataType> &arg_types) {
+    if (node.args.empty()) return;
+    int64_t id;
+    if (auto *lit = dynamic_cast<const IntegerLiteral *>(node.args[0].get())) {
+        id = lit->value;
+    } else if (auto *member = dynamic_cast<const EnumAccessExpression *>(node.args[0].get())) {
+        id = member->value;
+    } else {
+        return;
+    }
+    int index = ir::find_syscall(id);
+    if (index < 0) return;
+    const auto &sig = ir::Syscalls[index];
+
+    bool forwards = dynamic_cast<const VarargExpression *>(node.args.back().get()) != nullptr;
+    size_t num_args = node.args.size() - 1 - (forwards ? 1 : 0);
+    bool variadic = sig.max_args == ir::SyscallSignature::VariadicArgs;
+    if ((!forwards && num_args < sig.min_args) || (!variadic && num_args > sig.max_args)) {
+        throw CompilerError("Wrong number of arguments for syscall " + std::string(sig.name), node.filename, node.line,
+                            node.column, node.length);
+    }
+    for (size_t i = 0; i < num_args; ++i) {
+        const DataType &type = arg_types[i + 1];
+        bool ok = true;
+        std::string_view expected;
+        switch (sig.arg(i)) {
+            case ir::SyscallArg::Any:
+                break;
+            case ir::SyscallArg::Int:
+                ok = type.is_integer();
+                expected = "an integer";
+                break;
+            case ir::SyscallArg::String:
+                ok = type.kind == DataType::Kind::String;
+                expected = "string";
+                break;
+            case ir::SyscallArg::Bytes:
+                ok = type.kind == DataType::Kind::Bytes;
+                expected = "bytes";
+                break;
+            case ir::SyscallArg::Text:
+                ok = type.kind == DataType::Kind::String || type.kind == DataType::Kind::Bytes;
+                expected = "string or bytes";
+                break;
+            case ir::SyscallArg::Buffer:
+                ok = type.kind == DataType::Kind::String || type.kind == DataType::Kind::Bytes ||
+                     type.kind == DataType::Kind::Ptr || type.kind == DataType::Kind::Array ||
+                     type.kind == DataType::Kind::Struct;
+                expected = "a buffer";
+                break;
+        }
+        if (!ok) {
+            const auto &arg = *node.args[i + 1];
+            throw CompilerError("Invalid argument " + std::to_string(i + 1) + " for syscall " + std::string(sig.name) +
+                                    ": expected " + std::string(expected) + ", got " + type.to_string(),
+                                arg.filename, arg.line, arg.column, arg.length);
+        }
+    }
+    // A forwarded `...` may add any number of arguments, so only a variadic syscall whose checked arguments already
+    // cover the required ones is resolved ahead of time. Any other call is checked when it runs.
+    if (!forwards || (variadic && num_args >= sig.min_args)) node.syscall_index = index;
+}
+
 void Analyzer::visit(VarargExpression &node) {
     // ellipsis can only appear in calls, and their type is effectively "multiple"
     // for now we just mark current type as i32 so it doesn't crash
@@ -344,6 +413,12 @@ void Analyzer::visit(AssignmentExpression &node) {
     node.lvalue->accept(*this);
     DataType lval_type = m_current_type;
 
+    if (auto *idx = dynamic_cast<IndexExpression *>(node.lvalue.get());
+        idx && idx->object->type && idx->object->type->kind == DataType::Kind::Bytes) {
+        throw CompilerError("Cannot assign through a read-only bytes view", node.filename, node.line, node.column,
+                            node.length);
+    }
+
     if (!(val_type == lval_type)) {
         bool is_null_ptr = (lval_type.kind == DataType::Kind::Ptr && val_type.is_integer());
         bool is_ptr_cast = (lval_type.kind == DataType::Kind::Ptr && val_type.kind == DataType::Kind::Ptr);
@@ -496,7 +571,7 @@ void Analyzer::visit(IndexExpression &node) {
 
     // Verify that object is a pointer or an array
     if (obj_type.kind != DataType::Kind::Ptr && obj_type.kind != DataType::Kind::Array &&
-        obj_type.kind != DataType::Kind::String) {
+        obj_type.kind != DataType::Kind::String && obj_type.kind != DataType::Kind::Bytes) {
         throw CompilerError("Index operator '[]' requires a pointer or array, but got " + obj_type.to_string(),
                             node.filename, node.line, node.column, node.length);
     }
@@ -510,7 +585,7 @@ void Analyzer::visit(IndexExpression &node) {
     }
 
     // The result type is inner type of pointer or array
-    if (obj_type.kind == DataType::Kind::String) {
+    if (obj_type.kind == DataType::Kind::String || obj_type.kind == DataType::Kind::Bytes) {
         m_current_type = DataType(DataType::Kind::I8);
     } else if (obj_type.inner) {
         m_current_type = *obj_type.inner;
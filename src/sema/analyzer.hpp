@@ -83,6 +83,7 @@ class Analyzer : public parser::ASTVisitor {
     parser::DataType lookup_variable(const std::string &name, std::string filename, int line, int col);
     const Symbol *lookup_symbol(const std::string &name);
     const FunctionInfo *lookup_function(const std::string &name);
+    void check_syscall(parser::FunctionCall &node, const std::vector<parser::DataType> &arg_types);
 };
 
 }  // namespace ether::sema
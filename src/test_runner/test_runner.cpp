@@ -63,8 +63,8 @@ TestResult perform_test(const std::string& ether_bin, const TestCase& tc) {
         if (tc.expected_outputs.empty() && tc.not_expected_outputs.empty() && !tc.expected_result.has_value()) {
             return {false, tc.path.string(), 0, {}, "NOTHING TO TEST", ""};
         }
-        // Use 'timeout 1s' to prevent hanging
-        std::string cmd = "timeout 1s " + ether_bin + " " + tc.path.string() + " " + tc.args + " 2>&1";
+        // Use 'timeout 1s' to prevent hanging. Tests always compile, and leave nothing in the user's bytecode cache.
+        std::string cmd = "timeout 1s " + ether_bin + " " + tc.path.string() + " --no-cache " + tc.args + " 2>&1";
         ExecResult res = exec(cmd);
         std::string output = res.output;
 
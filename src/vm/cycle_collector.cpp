@@ -0,0 +1,145 @@
+#include "cycle_collector.hpp"
+
+#include <cstdlib>
+
+namespace ether::vm {
+
+namespace {
+
+template <typename F>
+void for_each_child(ArrayObj *obj, F &&fn) {
+    for (uint32_t i = 0; i < obj->slots; ++i) {
+        const Value &v = obj->data[i];
+        if (v.type == ValueType::Array && v.as.arr) fn(array_obj_from_data(v.as.arr));
+    }
+}
+
+// Set by CycleCollector::Scope while a VM runs on this thread
+thread_local CycleCollector *current_collector = nullptr;
+
+}  // namespace
+
+void buffer_possible_cycle_root(ArrayObj *obj) {
+    if (!current_collector) return;
+    obj->buffered = true;
+    current_collector->add_root(obj);
+}
+
+CycleCollector::Scope::Scope(CycleCollector &collector) : m_previous(current_collector) {
+    current_collector = &collector;
+}
+
+CycleCollector::Scope::~Scope() { current_collector = m_previous; }
+
+size_t CycleCollector::collect(size_t max_work) {
+    m_freed = 0;
+    m_visited = 0;
+
+    // Mark: subtract internal references below every candidate still alive. The newest candidates are taken first,
+    // until the budget runs out; the rest stay buffered for a later tick.
+    std::vector<ArrayObj *> roots;
+    while (!m_roots.empty() && m_visited < max_work) {
+        ArrayObj *obj = m_roots.back();
+        m_roots.pop_back();
+        m_visited++;
+        if (obj->color == GcColor::Purple && obj->ref_count > 0) {
+            mark_gray(obj);
+            roots.push_back(obj);
+        } else {
+            obj->buffered = false;
+            // Its count reached zero while buffered, so releasing it left the memory to us
+            if (obj->color == GcColor::Black && obj->ref_count == 0) {
+                free(obj);
+                m_freed++;
+            }
+        }
+    }
+
+    // Scan: anything still referenced from outside is live, and so is everything it reaches
+    for (ArrayObj *obj : roots) scan(obj);
+
+    // Collect: the candidates are unbuffered first, so a candidate reached from an earlier one is freed right away
+    for (ArrayObj *obj : roots) obj->buffered = false;
+    for (ArrayObj *obj : roots) collect_white(obj);
+    // Freed only now, since the traversal may meet the same garbage through several parents
+    for (ArrayObj *obj : m_garbage) free(obj);
+    m_freed += m_garbage.size();
+    m_garbage.clear();
+    m_total_freed += m_freed;
+    return m_freed;
+}
+
+void CycleCollector::mark_gray(ArrayObj *root) {
+    m_work.push_back(root);
+    while (!m_work.empty()) {
+        ArrayObj *obj = m_work.back();
+        m_work.pop_back();
+        if (obj->color == GcColor::Gray) continue;
+        obj->color = GcColor::Gray;
+        // Scan and collect only ever visit what was marked, so this bounds the whole collection
+        m_visited += 1 + obj->slots;
+        for_each_child(obj, [&](ArrayObj *child) {
+            child->ref_count--;
+            m_work.push_back(child);
+        });
+    }
+}
+
+void CycleCollector::scan(ArrayObj *root) {
+    m_work.push_back(root);
+    while (!m_work.empty()) {
+        ArrayObj *obj = m_work.back();
+        m_work.pop_back();
+        if (obj->color != GcColor::Gray) continue;
+        if (obj->ref_count > 0) {
+            scan_black(obj);
+        } else {
+            obj->color = GcColor::White;
+            for_each_child(obj, [&](ArrayObj *child) { m_work.push_back(child); });
+        }
+    }
+}
+
+void CycleCollector::scan_black(ArrayObj *root) {
+    // Runs from inside scan(), so it keeps its own stack
+    std::vector<ArrayObj *> work{root};
+    root->color = GcColor::Black;
+    while (!work.empty()) {
+        ArrayObj *obj = work.back();
+        work.pop_back();
+        for_each_child(obj, [&](ArrayObj *child) {
+            child->ref_count++;
+            if (child->color != GcColor::Black) {
+                child->color = GcColor::Black;
+                work.push_back(child);
+            }
+        });
+    }
+}
+
+void CycleCollector::collect_white(ArrayObj *root) {
+    m_work.push_back(root);
+    while (!m_work.empty()) {
+        ArrayObj *obj = m_work.back();
+        m_work.pop_back();
+        if (obj->color != GcColor::White) continue;
+        obj->color = GcColor::Black;
+        // References to other arrays were already subtracted by mark_gray; strings and mapped files still need their
+        // release
+        for (uint32_t i = 0; i < obj->slots; ++i) {
+            Value &v = obj->data[i];
+            if (v.type == ValueType::Array && v.as.arr) {
+                m_work.push_back(array_obj_from_data(v.as.arr));
+            } else if (v.type == ValueType::String) {
+                release_string_data(v.as.str);
+            } else if (v.type == ValueType::Bytes) {
+                release_bytes(v.as.bytes);
+            }
+        }
+        obj->ref_count = 0;
+        // One still in the candidate buffer is freed when a later collection gets to it
+        if (!obj->buffered) m_garbage.push_back(obj);
+    }
+}
+
+}  // namespace ether::vm
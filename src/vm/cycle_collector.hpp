@@ -0,0 +1,66 @@
+#ifndef ETHER_VM_CYCLE_COLLECTOR_HPP
+#define ETHER_VM_CYCLE_COLLECTOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "vm.hpp"
+
+namespace ether::vm {
+
+// Synchronous trial deletion after Bacon and Rajan, "Concurrent Cycle Collection in Reference Counted Systems". An
+// array whose count drops to a nonzero value is buffered as a candidate root. A collection subtracts the references
+// internal to the graph below some candidates; whatever is left with no outside references is garbage. The VM only
+// runs a collection between scheduler ticks, when every reference to an array is counted, and caps the work each one
+// does so a pause stays short. Strings cannot point at anything and are never candidates.
+//
+// Every VM owns a collector. Arrays are released from Value destructors, which have no VM at hand, so a VM makes its
+// collector the thread's current one while it runs; arrays released outside any VM are not buffered, and a cycle
+// among them leaks as it would under plain reference counting.
+class CycleCollector {
+   public:
+    // Buffered candidates before the scheduler starts collecting
+    static constexpr size_t CollectThreshold = 1024;
+    // Array slots a collection visits before it stops taking new candidates. The graph below the candidate it is on
+    // is still traversed whole, since trial deletion cannot stop halfway through one.
+    static constexpr size_t WorkBudget = 16384;
+
+    // Makes `collector` the current one for its lifetime
+    class Scope {
+       public:
+        explicit Scope(CycleCollector &collector);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+       private:
+        CycleCollector *m_previous;
+    };
+
+    void add_root(ArrayObj *obj) { m_roots.push_back(obj); }
+    size_t pending() const { return m_roots.size(); }
+    // Takes candidates until about `max_work` array slots have been visited and returns how many arrays it freed
+    size_t collect(size_t max_work);
+    // Looks at every buffered candidate
+    size_t collect_all() { return collect(SIZE_MAX); }
+    // Arrays freed by every collection so far
+    size_t total_freed() const { return m_total_freed; }
+
+   private:
+    std::vector<ArrayObj *> m_roots;
+    std::vector<ArrayObj *> m_work;
+    std::vector<ArrayObj *> m_garbage;
+    size_t m_freed = 0;
+    size_t m_total_freed = 0;
+    size_t m_visited = 0;
+
+    void mark_gray(ArrayObj *obj);
+    void scan(ArrayObj *obj);
+    void scan_black(ArrayObj *obj);
+    void collect_white(ArrayObj *obj);
+};
+
+}  // namespace ether::vm
+
+#endif  // ETHER_VM_CYCLE_COLLECTOR_HPP
@@ -0,0 +1,152 @@
+#include "format.hpp"
+
+#include <charconv>
+
+#include "vm.hpp"
+
+namespace ether::vm {
+
+static void append_literal(CompiledFormat &format, std::string_view text) {
+    if (!format.empty() && format.back().kind == FormatSegment::Kind::Literal) {
+        format.back().text.append(text);
+    } else {
+        format.push_back({FormatSegment::Kind::Literal, -1, std::string(text)});
+    }
+}
+
+CompiledFormat compile_format(std::string_view fmt) {
+    CompiledFormat format;
+    for (size_t i = 0; i < fmt.size(); ++i) {
+        if (fmt[i] == '%' && i + 1 < fmt.size()) {
+            i++;
+            int precision = -1;
+            if (fmt[i] == '.') {
+                i++;
+                while (i < fmt.size() && fmt[i] >= '0' && fmt[i] <= '9') {
+                    if (precision == -1) {
+                        precision = 0;
+                    }
+                    precision = precision * 10 + (fmt[i] - '0');
+                    i++;
+                }
+            }
+            if (i >= fmt.size()) {
+                append_literal(format, "%");
+                break;
+            }
+            switch (fmt[i]) {
+                case 'd':
+                    format.push_back({FormatSegment::Kind::Int, -1, "%d"});
+                    break;
+                case 'f':
+                    format.push_back({FormatSegment::Kind::Float, precision, "%f"});
+                    break;
+                case 's':
+                    format.push_back({FormatSegment::Kind::String, -1, "%s"});
+                    break;
+                case 'p':
+                    format.push_back({FormatSegment::Kind::Pointer, -1, "%p"});
+                    break;
+                default: {
+                    char text[2] = {'%', fmt[i]};
+                    append_literal(format, std::string_view(text, 2));
+                    break;
+                }
+            }
+        } else if (fmt[i] == '\\' && i + 1 < fmt.size()) {
+            i++;
+            if (fmt[i] == 'n') {
+                append_literal(format, "\n");
+            } else if (fmt[i] == 't') {
+                append_literal(format, "\t");
+            } else {
+                char text[2] = {'\\', fmt[i]};
+                append_literal(format, std::string_view(text, 2));
+            }
+        } else {
+            append_literal(format, fmt.substr(i, 1));
+        }
+    }
+    return format;
+}
+
+static bool is_integer(const Value &v) {
+    return v.type == ValueType::I64 || v.type == ValueType::I32 || v.type == ValueType::I16 ||
+           v.type == ValueType::I8;
+}
+
+void render_format(const CompiledFormat &format, const Value *args, size_t num_args, FloatFormat &float_format,
+                   std::string &out) {
+    char buf[64];
+    size_t arg_idx = 0;
+    for (const auto &segment : format) {
+        const Value *arg = arg_idx < num_args ? &args[arg_idx] : nullptr;
+        switch (segment.kind) {
+            case FormatSegment::Kind::Literal:
+                out.append(segment.text);
+                break;
+            case FormatSegment::Kind::Int: {
+                if (!arg || !is_integer(*arg)) {
+                    out.append(segment.text);
+                    break;
+                }
+                auto res = std::to_chars(buf, buf + sizeof(buf), arg->i64_value());
+                out.append(buf, res.ptr);
+                arg_idx++;
+                break;
+            }
+            case FormatSegment::Kind::Float: {
+                if (!arg || (arg->type != ValueType::F64 && arg->type != ValueType::F32)) {
+                    out.append(segment.text);
+                    break;
+                }
+                if (segment.precision != -1) {
+                    float_format.fixed = true;
+                    float_format.precision = segment.precision;
+                }
+                auto fmt = float_format.fixed ? std::chars_format::fixed : std::chars_format::general;
+                auto res = std::to_chars(buf, buf + sizeof(buf), arg->f64_value(), fmt, float_format.precision);
+                if (res.ec == std::errc()) {
+                    out.append(buf, res.ptr);
+                } else {
+                    // Huge fixed-notation values do not fit the stack buffer
+                    std::string big(512, '\0');
+                    res = std::to_chars(big.data(), big.data() + big.size(), arg->f64_value(), fmt,
+                                        float_format.precision);
+                    out.append(big.data(), res.ptr);
+                }
+                arg_idx++;
+                break;
+            }
+            case FormatSegment::Kind::String: {
+                if (arg && arg->type == ValueType::String) {
+                    out.append(arg->as_string());
+                } else if (arg && arg->type == ValueType::Bytes) {
+                    out.append(arg->as_bytes());
+                } else {
+                    out.append(segment.text);
+                    break;
+                }
+                arg_idx++;
+                break;
+            }
+            case FormatSegment::Kind::Pointer: {
+                if (!arg || arg->type != ValueType::Ptr) {
+                    out.append(segment.text);
+                    break;
+                }
+                if (!arg->as.ptr) {
+                    out.push_back('0');
+                } else {
+                    out.append("0x");
+                    auto res = std::to_chars(buf, buf + sizeof(buf), (uintptr_t)arg->as.ptr, 16);
+                    out.append(buf, res.ptr);
+                }
+                arg_idx++;
+                break;
+            }
+        }
+    }
+}
+
+}  // namespace ether::vm
@@ -0,0 +1,36 @@
+#ifndef ETHER_VM_FORMAT_HPP
+#define ETHER_VM_FORMAT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ether::vm {
+
+struct Value;
+
+// A printf format string split into literal runs and conversions, so it is only scanned once.
+struct FormatSegment {
+    enum class Kind : uint8_t { Literal, Int, Float, String, Pointer };
+    Kind kind;
+    int precision = -1;  // Float only, -1 when not given
+    std::string text;    // Literal text, or what to print when the argument does not match the conversion
+};
+
+using CompiledFormat = std::vector<FormatSegment>;
+
+// Float formatting state. Like the std::cout flags printf used to go through, an explicit precision sticks.
+struct FloatFormat {
+    bool fixed = false;
+    int precision = 6;
+};
+
+CompiledFormat compile_format(std::string_view fmt);
+void render_format(const CompiledFormat &format, const Value *args, size_t num_args, FloatFormat &float_format,
+                   std::string &out);
+
+}  // namespace ether::vm
+
+#endif  // ETHER_VM_FORMAT_HPP
@@ -0,0 +1,33 @@
+#include <algorithm>
+
+#include "vm.hpp"
+
+namespace ether::vm {
+
+Value *FrameArena::allocate(size_t count) {
+    while (m_current < m_chunks.size() && m_chunks[m_current].size - m_chunks[m_current].used < count) {
+        if (m_current + 1 == m_chunks.size()) break;
+        m_current++;
+    }
+    if (m_chunks.empty() || m_chunks[m_current].size - m_chunks[m_current].used < count) {
+        size_t size = std::max(ChunkSize, count);
+        m_chunks.push_back({std::make_unique<Value[]>(size), size});
+        m_current = m_chunks.size() - 1;
+    }
+    Chunk &chunk = m_chunks[m_current];
+    Value *data = chunk.data.get() + chunk.used;
+    chunk.used += count;
+    return data;
+}
+
+void FrameArena::release(Mark mark) {
+    for (size_t i = mark.chunk; i <= m_current && i < m_chunks.size(); ++i) {
+        Chunk &chunk = m_chunks[i];
+        size_t from = i == mark.chunk ? mark.used : 0;
+        std::fill(chunk.data.get() + from, chunk.data.get() + chunk.used, Value());
+        chunk.used = from;
+    }
+    m_current = mark.chunk;
+}
+
+}  // namespace ether::vm
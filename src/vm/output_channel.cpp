@@ -0,0 +1,75 @@
+#include "output_channel.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace ether::vm {
+
+OutputChannel::OutputChannel(int fd, struct io_uring *ring, uint64_t user_data, size_t limit)
+    : m_fd(fd),
+      m_is_tty(isatty(fd)),
+      m_ring(ring),
+      m_user_data(user_data),
+      m_limit(limit),
+      m_flush_at(std::clamp<size_t>(limit, 1, BufferCapacity)) {
+    m_pending.reserve(m_flush_at);
+}
+
+void OutputChannel::write(std::string_view data) {
+    m_pending.append(data);
+    if (m_pending.size() >= m_flush_at || (m_is_tty && data.find('\n') != std::string_view::npos)) {
+        flush();
+    }
+}
+
+void OutputChannel::flush() {
+    resubmit();
+    if (m_pending.empty()) return;
+
+    // One write in flight at a time keeps the output ordered; on_complete() picks up what arrived meanwhile.
+    if (in_flight()) {
+        m_flush_requested = true;
+        return;
+    }
+    m_flush_requested = false;
+    m_in_flight.swap(m_pending);
+    m_written = 0;
+    submit();
+}
+
+void OutputChannel::submit() {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(m_ring);
+    if (!sqe) {
+        io_uring_submit(m_ring);
+        sqe = io_uring_get_sqe(m_ring);
+    }
+    // Still no room in the ring: the chunk stays in flight, ahead of anything queued after it, and goes out once a
+    // completion or the next flush() makes space
+    m_submit_deferred = !sqe;
+    if (!sqe) return;
+    // Offset -1 appends at the current file position, so redirected output is not written at offset 0
+    io_uring_prep_write(sqe, m_fd, m_in_flight.data() + m_written, m_in_flight.size() - m_written, (uint64_t)-1);
+    io_uring_sqe_set_data(sqe, (void *)(uintptr_t)m_user_data);
+    io_uring_submit(m_ring);
+}
+
+void OutputChannel::resubmit() {
+    if (m_submit_deferred) submit();
+}
+
+void OutputChannel::on_complete(int32_t res) {
+    if (res > 0 && m_written + (size_t)res < m_in_flight.size()) {
+        m_written += (size_t)res;
+        submit();
+        return;
+    }
+    // Finished, or the reader went away: either way this batch is done.
+    m_in_flight.clear();
+    m_written = 0;
+    if (m_flush_requested || m_pending.size() >= m_flush_at) {
+        flush();
+    }
+}
+
+}  // namespace ether::vm
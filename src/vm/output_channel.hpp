@@ -0,0 +1,65 @@
+#ifndef ETHER_VM_OUTPUT_CHANNEL_HPP
+#define ETHER_VM_OUTPUT_CHANNEL_HPP
+
+#include <liburing.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace ether::vm {
+
+// What console output does once its queue is full: park the writing coroutine until the reader catches up, or
+// discard the write and report -EAGAIN.
+enum class OutputPolicy : uint8_t { Block, Drop };
+
+// Buffered writer for the VM's stdout and stderr. All writes go through io_uring, so a slow reader never stalls the
+// VM thread; the next batch accumulates while the previous one is in flight. On a terminal each line is flushed as
+// soon as it is complete. The queue holds at most `limit` bytes, and callers check has_room() or over_limit() to
+// apply an OutputPolicy.
+class OutputChannel {
+   public:
+    static constexpr size_t BufferCapacity = 64 * 1024;
+
+    OutputChannel(int fd, struct io_uring *ring, uint64_t user_data, size_t limit);
+
+    void write(std::string_view data);
+    // Starts writing whatever is buffered, or as soon as the write in flight completes.
+    void flush();
+    // Completion of the write submitted by flush(), matched by user_data.
+    void on_complete(int32_t res);
+    // Submits the write in flight if the ring was full when it was first tried.
+    void resubmit();
+
+    int fd() const { return m_fd; }
+    uint64_t user_data() const { return m_user_data; }
+    bool in_flight() const { return !m_in_flight.empty(); }
+    bool empty() const { return m_pending.empty() && m_in_flight.empty(); }
+    size_t queued() const { return m_pending.size() + m_in_flight.size() - m_written; }
+    bool has_room(size_t bytes) const { return queued() + bytes <= m_limit; }
+    bool over_limit() const { return queued() > m_limit; }
+
+    void count_dropped(size_t bytes) { m_dropped += bytes; }
+    uint64_t dropped() const { return m_dropped; }
+
+   private:
+    int m_fd;
+    bool m_is_tty;
+    struct io_uring *m_ring;
+    uint64_t m_user_data;
+    size_t m_limit;
+    size_t m_flush_at;  // Pending size that starts a write without waiting for the scheduler to go idle
+    bool m_flush_requested = false;
+    std::string m_pending;
+    std::string m_in_flight;         // Owned by the kernel until on_complete()
+    size_t m_written = 0;            // Bytes of m_in_flight already written
+    bool m_submit_deferred = false;  // Waiting for room in the ring to submit m_in_flight
+    uint64_t m_dropped = 0;
+
+    void submit();
+};
+
+}  // namespace ether::vm
+
+#endif  // ETHER_VM_OUTPUT_CHANNEL_HPP
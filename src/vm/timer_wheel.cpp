@@ -0,0 +1,61 @@
+#include "timer_wheel.hpp"
+
+#include <limits>
+
+namespace ether::vm {
+
+void TimerWheel::schedule(uint64_t deadline_ms, uint32_t id) {
+    m_size++;
+    if (deadline_ms <= m_now) {
+        m_due.push_back({deadline_ms, id});
+        return;
+    }
+    place({deadline_ms, id});
+}
+
+void TimerWheel::place(const Timer &timer) {
+    uint64_t delta = timer.deadline - m_now;
+    uint32_t level = 0;
+    while (level + 1 < NumLevels && delta >= (uint64_t(1) << (SlotBits * (level + 1)))) {
+        level++;
+    }
+    m_slots[level][(timer.deadline >> (SlotBits * level)) & (NumSlots - 1)].push_back(timer);
+}
+
+void TimerWheel::cascade() {
+    for (uint32_t level = NumLevels - 1; level > 0; --level) {
+        uint64_t unit = uint64_t(1) << (SlotBits * level);
+        if (m_now & (unit - 1)) continue;
+        auto &slot = m_slots[level][(m_now >> (SlotBits * level)) & (NumSlots - 1)];
+        if (slot.empty()) continue;
+        auto timers = std::move(slot);
+        slot.clear();
+        for (const auto &timer : timers) {
+            place(timer);
+        }
+    }
+}
+
+uint64_t TimerWheel::next_event_tick() const {
+    uint64_t best = std::numeric_limits<uint64_t>::max();
+    for (uint64_t i = 1; i <= NumSlots; ++i) {
+        if (!m_slots[0][(m_now + i) & (NumSlots - 1)].empty()) {
+            best = m_now + i;
+            break;
+        }
+    }
+    for (uint32_t level = 1; level < NumLevels; ++level) {
+        uint64_t block = m_now >> (SlotBits * level);
+        uint64_t current = block & (NumSlots - 1);
+        for (uint64_t slot = 0; slot < NumSlots; ++slot) {
+            if (m_slots[level][slot].empty()) continue;
+            uint64_t distance = (slot - current) & (NumSlots - 1);
+            if (distance == 0) distance = NumSlots;
+            uint64_t tick = (block + distance) << (SlotBits * level);
+            if (tick < best) best = tick;
+        }
+    }
+    return best;
+}
+
+}  // namespace ether::vm
@@ -0,0 +1,89 @@
+#ifndef ETHER_VM_TIMER_WHEEL_HPP
+#define ETHER_VM_TIMER_WHEEL_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace ether::vm {
+
+// Hierarchical timer wheel with 1ms ticks. Each level has 64 slots and covers 64 times the range of the level
+// below it, so scheduling and expiring a timer are O(1); timers further away than the top level are re-filed when
+// their slot comes around.
+class TimerWheel {
+   public:
+    static constexpr uint32_t SlotBits = 6;
+    static constexpr uint32_t NumSlots = 1u << SlotBits;
+    static constexpr uint32_t NumLevels = 4;
+
+    explicit TimerWheel(uint64_t now_ms = 0) : m_now(now_ms) {}
+
+    static uint64_t now_ms() {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+    }
+
+    void schedule(uint64_t deadline_ms, uint32_t id);
+
+    // Fires every timer whose deadline is <= now_ms.
+    template <typename F>
+    void advance(uint64_t now_ms, F &&on_expire) {
+        if (!m_due.empty()) {
+            auto due = std::move(m_due);
+            m_due.clear();
+            m_size -= due.size();
+            for (const auto &timer : due) on_expire(timer.id);
+        }
+        while (m_size > 0 && m_now < now_ms) {
+            uint64_t tick = next_event_tick();
+            if (tick > now_ms) break;
+            m_now = tick;
+            cascade();
+            auto expired = std::move(m_slots[0][m_now & (NumSlots - 1)]);
+            m_slots[0][m_now & (NumSlots - 1)].clear();
+            for (const auto &timer : expired) {
+                if (timer.deadline <= m_now) {
+                    m_size--;
+                    on_expire(timer.id);
+                } else {
+                    place(timer);
+                }
+            }
+        }
+        if (m_now < now_ms) m_now = now_ms;
+    }
+
+    // Earliest time at which advance() may have work to do. This can be a slot boundary rather than an actual
+    // deadline, which is fine for arming a wake-up: the wheel just re-files and asks again.
+    std::optional<uint64_t> next_deadline() const {
+        if (m_size == 0) return std::nullopt;
+        if (!m_due.empty()) return m_now;
+        return next_event_tick();
+    }
+
+    bool empty() const { return m_size == 0; }
+    size_t size() const { return m_size; }
+
+   private:
+    struct Timer {
+        uint64_t deadline;
+        uint32_t id;
+    };
+
+    std::array<std::array<std::vector<Timer>, NumSlots>, NumLevels> m_slots;
+    std::vector<Timer> m_due;  // Already expired when scheduled
+    uint64_t m_now;
+    size_t m_size = 0;
+
+    void place(const Timer &timer);
+    void cascade();
+    uint64_t next_event_tick() const;
+};
+
+}  // namespace ether::vm
+
+#endif  // ETHER_VM_TIMER_WHEEL_HPP
@@ -1,5 +1,7 @@
 #include "vm.hpp"
 
+#include <unistd.h>
+
 #include <cstdlib>
 #include <cstring>
 #include <memory>
@@ -7,6 +9,7 @@
 
 // #define DEBUG
 #include "common/debug.hpp"
+#include "cycle_collector.hpp"
 
 namespace ether::vm {
 
@@ -36,19 +39,22 @@ static Value concat_strings(const Value &a, const Value &b) {
     return res;
 }
 
-VM::VM(const ir::IRProgram &program) : program_(program) {
+VM::VM(const ir::ProgramView &program, const VMOptions &options)
+    : program_(program),
+      m_timers(TimerWheel::now_ms()),
+      m_stdout(STDOUT_FILENO, &m_ring, OutputTag | STDOUT_FILENO, options.output_buffer),
+      m_stderr(STDERR_FILENO, &m_ring, OutputTag | STDERR_FILENO, options.output_buffer),
+      m_output_policy(options.output_policy) {
+    m_cycles = std::make_unique<CycleCollector>();
     m_globals.resize(program.num_globals, Value(0));
     // Initial coroutine for main
     auto main_coro = std::make_unique<Coroutine>();
     main_coro->id = 0;  // Main is always ID 0
     main_coro->ip = program.main_addr;
-    main_coro->call_stack.push_back({0, 0, 0, 0});
+    main_coro->call_stack.push_back({0, 0, 0, 0, program.main_slots});
 
     // Pre-allocate slots for main
-    auto main_it = program.functions.find("main");
-    if (main_it != program.functions.end()) {
-        main_coro->stack.resize(main_it->second.num_slots);
-    }
+    main_coro->stack.resize(program.main_slots);
     // Reserve large capacity to prevent pointer invalidation
     main_coro->stack.reserve(65536);
 
@@ -57,16 +63,36 @@ VM::VM(const ir::IRProgram &program) : program_(program) {
     if (io_uring_queue_init(32, &m_ring, 0) < 0) {
         throw std::runtime_error("Failed to initialize io_uring");
     }
+    probe_ring_ops();
+}
+
+VM::~VM() {
+    drain_output();
+    io_uring_queue_exit(&m_ring);
+    // Drop every reference while the collector is still current, then let it free the cycles and the memory of the
+    // candidates left with no references, so nothing stays buffered in a collector that is going away
+    CycleCollector::Scope scope(*m_cycles);
+    m_coroutines.clear();
+    m_finished_coros.clear();
+    m_globals.clear();
+    m_cycles->collect_all();
 }
 
-VM::~VM() { io_uring_queue_exit(&m_ring); }
+size_t VM::cycles_freed() const { return m_cycles->total_freed(); }
 
 Value VM::run(bool collect_stats) {
     const auto &program = program_;
     const uint8_t *code = program.bytecode.data();
+    const ir::IRProgram::FunctionInfo *function_table = program.function_table.data();
     Value main_result(0);
+    CycleCollector &cycles = *m_cycles;
+    CycleCollector::Scope cycle_scope(cycles);
 
     while (!m_coroutines.empty()) {
+        // Between ticks every reference to an array is a counted Value, so a slice of cycle collection can run
+        if (cycles.pending() >= CycleCollector::CollectThreshold) {
+            cycles.collect(CycleCollector::WorkBudget);
+        }
         m_current_coro %= m_coroutines.size();
         debug_msg("Current coroutine: " << *m_coroutines[m_current_coro]);
 
@@ -132,6 +158,9 @@ Value VM::run(bool collect_stats) {
             }
 
             if (!can_progress) {
+                // Everything is blocked, so this is the moment to let buffered output out
+                m_stdout.flush();
+                m_stderr.flush();
                 struct io_uring_cqe *cqe;
                 io_uring_wait_cqe(&m_ring, &cqe);
                 handle_io_completion();
@@ -161,6 +190,11 @@ Value VM::run(bool collect_stats) {
         while (!yielded) {
             if (CUR_CORO().ip == 0xFFFFFFFF) {
                 submit_syscall(CUR_CORO(), CUR_CORO().call_stack.back().num_args_passed);
+                if (!CUR_CORO().waiting_for_io) {
+                    // Completed without going through the ring, e.g. a console write
+                    CUR_CORO().result = CUR_CORO().stack.back();
+                    CUR_CORO().finished = true;
+                }
                 yielded = true;
                 break;
             }
@@ -203,7 +237,9 @@ Value VM::run(bool collect_stats) {
 
                 case ir::OpCode::PUSH_STR: {
                     uint32_t string_id = READ_UINT32();
-                    push(make_string_value(std::string_view(program.string_pool[string_id])));
+                    Value str = make_string_value(program.string_pool[string_id]);
+                    string_obj_from_data(str.as.str)->pool_id = string_id;
+                    push(std::move(str));
                     break;
                 }
 
@@ -235,6 +271,25 @@ Value VM::run(bool collect_stats) {
                     }
                     char c = (char)char_val.i64_value();
                     str_val.as.str[idx] = c;
+                    string_obj_from_data(str_val.as.str)->pool_id = NoPoolId;
+                    break;
+                }
+
+                case ir::OpCode::LOAD_BYTE: {
+                    Value idx_val = pop();
+                    Value view_val = pop();
+                    if (view_val.type != ValueType::Bytes) {
+                        throw std::runtime_error("LOAD_BYTE expects bytes value");
+                    }
+                    const BytesObj *view = view_val.as.bytes;
+                    if (view && view->closed) {
+                        throw std::runtime_error("Bytes view used after munmap");
+                    }
+                    int64_t idx = idx_val.i64_value();
+                    if (!view || idx < 0 || static_cast<uint64_t>(idx) >= view->len) {
+                        throw std::runtime_error("Bytes index out of bounds");
+                    }
+                    push(Value((int8_t)view->data[idx]));
                     break;
                 }
 
@@ -260,12 +315,30 @@ Value VM::run(bool collect_stats) {
                     break;
                 }
 
+                case ir::OpCode::FRAME_ALLOC: {
+                    uint16_t slot = READ_UINT16();
+                    uint32_t slots = READ_UINT32();
+                    auto &coro = CUR_CORO();
+                    auto &frame = coro.call_stack.back();
+                    if (!frame.frame_data) {
+                        frame.arena_mark = coro.frame_arena.mark();
+                        frame.frame_data = coro.frame_arena.allocate(frame.num_slots);
+                    }
+                    Value *data = frame.frame_data + slot;
+                    // The slots may still hold the previous loop iteration's values
+                    std::fill(data, data + slots, Value());
+                    push(Value((void *)data));
+                    break;
+                }
+
                 case ir::OpCode::STORE_VAR: {
                     uint16_t slot = READ_UINT16();
                     auto &stack = CUR_CORO().stack;
                     auto &call_stack = CUR_CORO().call_stack;
                     size_t base = call_stack.back().stack_base + slot;
-                    stack[base] = pop();
+                    Value value = pop();
+                    value.own();
+                    stack[base] = std::move(value);
                     break;
                 }
 
@@ -277,7 +350,9 @@ Value VM::run(bool collect_stats) {
 
                 case ir::OpCode::STORE_GLOBAL: {
                     uint16_t slot = READ_UINT16();
-                    m_globals[slot] = pop();
+                    Value value = pop();
+                    value.own();
+                    m_globals[slot] = std::move(value);
                     break;
                 }
 
@@ -290,6 +365,22 @@ Value VM::run(bool collect_stats) {
                     break;
                 }
 
+                case ir::OpCode::LOAD_VAR_BORROW: {
+                    uint16_t slot = READ_UINT16();
+                    auto &stack = CUR_CORO().stack;
+                    size_t base = CUR_CORO().call_stack.back().stack_base + slot;
+                    push(Value::borrow(stack[base]));
+                    break;
+                }
+
+                case ir::OpCode::LOAD_VAR_MOVE: {
+                    uint16_t slot = READ_UINT16();
+                    auto &stack = CUR_CORO().stack;
+                    size_t base = CUR_CORO().call_stack.back().stack_base + slot;
+                    push(std::move(stack[base]));
+                    break;
+                }
+
                 case ir::OpCode::ADD: {
                     Value b = pop();
                     Value a = pop();
@@ -374,8 +465,26 @@ Value VM::run(bool collect_stats) {
                     break;
                 }
 
+                case ir::OpCode::SYSCALL_N: {
+                    uint16_t index = READ_UINT16();
+                    uint8_t ir_num_args = READ_BYTE();
+                    uint8_t num_args_passed = ir_num_args;
+                    if (ir_num_args & 0x80) {
+                        uint8_t fixed = (ir_num_args & 0x7F) - 1;
+                        auto &frame = CUR_CORO().call_stack.back();
+                        uint8_t num_varargs = frame.num_args_passed - frame.num_fixed_params;
+                        num_args_passed = fixed + num_varargs;
+                    }
+                    auto &coro = CUR_CORO();
+                    run_syscall(coro, index, num_args_passed, 0);
+                    if (coro.waiting_for_io) {
+                        yielded = true;
+                    }
+                    break;
+                }
+
                 case ir::OpCode::CALL: {
-                    uint32_t target_addr = READ_UINT32();
+                    uint32_t func_index = READ_UINT32();
                     uint8_t ir_num_args = READ_BYTE();
                     uint8_t num_args_passed = ir_num_args;
                     if (ir_num_args & 0x80) {
@@ -385,19 +494,53 @@ Value VM::run(bool collect_stats) {
                         num_args_passed = fixed + num_varargs;
                     }
 
-                    const auto &info = program.addr_to_info.at(target_addr);
+                    const auto &info = function_table[func_index];
                     uint8_t num_params = info.num_params;
-                    uint8_t num_slots = info.num_slots;
+                    uint32_t num_slots = info.num_slots;
 
                     auto &stack = CUR_CORO().stack;
                     auto &call_stack = CUR_CORO().call_stack;
                     size_t base = stack.size() - num_args_passed;
-                    call_stack.push_back({CUR_CORO().ip, base, num_params, num_args_passed});
+                    call_stack.push_back({CUR_CORO().ip, base, num_params, num_args_passed, num_slots});
 
                     if (num_slots > num_args_passed) {
                         stack.resize(base + num_slots);
                     }
-                    CUR_CORO().ip = target_addr;
+                    CUR_CORO().ip = info.entry_addr;
+                    break;
+                }
+
+                case ir::OpCode::TAIL_CALL: {
+                    uint32_t func_index = READ_UINT32();
+                    uint8_t ir_num_args = READ_BYTE();
+                    uint8_t num_args_passed = ir_num_args;
+                    auto &frame = CUR_CORO().call_stack.back();
+                    if (ir_num_args & 0x80) {
+                        uint8_t fixed = (ir_num_args & 0x7F) - 1;
+                        uint8_t num_varargs = frame.num_args_passed - frame.num_fixed_params;
+                        num_args_passed = fixed + num_varargs;
+                    }
+
+                    const auto &info = function_table[func_index];
+                    auto &stack = CUR_CORO().stack;
+
+                    // Slide the arguments down over the current frame and reuse it, keeping its return address.
+                    // Arguments borrowed from the slots about to be overwritten take their own reference first.
+                    size_t base = frame.stack_base;
+                    for (auto it = stack.end() - num_args_passed; it != stack.end(); ++it) it->own();
+                    std::move(stack.end() - num_args_passed, stack.end(), stack.begin() + base);
+                    stack.resize(base + num_args_passed);
+                    if (info.num_slots > num_args_passed) {
+                        stack.resize(base + info.num_slots);
+                    }
+                    if (frame.frame_data) {
+                        CUR_CORO().frame_arena.release(frame.arena_mark);
+                        frame.frame_data = nullptr;
+                    }
+                    frame.num_fixed_params = info.num_params;
+                    frame.num_args_passed = num_args_passed;
+                    frame.num_slots = info.num_slots;
+                    CUR_CORO().ip = info.entry_addr;
                     break;
                 }
 
@@ -405,10 +548,12 @@ Value VM::run(bool collect_stats) {
                     auto &stack = CUR_CORO().stack;
                     auto &call_stack = CUR_CORO().call_stack;
 
-                    // Extract return values
+                    // Extract return values; a borrowed one may point into the frame being dropped
                     Value ret_val = pop();
+                    ret_val.own();
                     size_t ret_addr = call_stack.back().return_addr;
                     size_t stack_base = call_stack.back().stack_base;
+                    if (call_stack.back().frame_data) CUR_CORO().frame_arena.release(call_stack.back().arena_mark);
                     call_stack.pop_back();
 
                     if (call_stack.empty()) {
@@ -439,6 +584,15 @@ Value VM::run(bool collect_stats) {
                     break;
                 }
 
+                case ir::OpCode::JNZ: {
+                    int64_t condition = pop().i64_value();
+                    uint32_t target = READ_UINT32();
+                    if (condition != 0) {
+                        CUR_CORO().ip = target;
+                    }
+                    break;
+                }
+
                 case ir::OpCode::CMP_EQ: {
                     int64_t b = pop().i64_value();
                     int64_t a = pop().i64_value();
@@ -510,7 +664,7 @@ Value VM::run(bool collect_stats) {
                 }
 
                 case ir::OpCode::SPAWN: {
-                    uint32_t target_addr = READ_UINT32();
+                    uint32_t func_index = READ_UINT32();
                     uint8_t ir_num_args = READ_BYTE();
                     uint8_t num_args_passed = ir_num_args;
                     if (ir_num_args & 0x80) {
@@ -520,22 +674,25 @@ Value VM::run(bool collect_stats) {
                         num_args_passed = fixed + num_varargs;
                     }
                     uint8_t num_params;
-                    uint8_t num_slots;
+                    uint32_t num_slots;
+                    size_t target_addr;
 
-                    if (target_addr == 0xFFFFFFFF) {
+                    if (func_index == ir::IRProgram::NativeCall) {
                         num_params = num_args_passed;
                         num_slots = num_args_passed;
+                        target_addr = 0xFFFFFFFF;
                     } else {
-                        const auto &info = program.addr_to_info.at(target_addr);
+                        const auto &info = function_table[func_index];
                         num_params = info.num_params;
                         num_slots = info.num_slots;
+                        target_addr = info.entry_addr;
                     }
 
                     auto new_coro = std::make_unique<Coroutine>();
                     uint32_t new_id = m_next_coro_id++;
                     new_coro->id = new_id;
                     new_coro->ip = target_addr;
-                    new_coro->call_stack.push_back({0, 0, num_params, num_args_passed});
+                    new_coro->call_stack.push_back({0, 0, num_params, num_args_passed, num_slots});
 
                     new_coro->stack.resize(num_args_passed);
                     auto &stack = CUR_CORO().stack;
@@ -593,6 +750,25 @@ Value VM::run(bool collect_stats) {
                     break;
                 }
 
+                case ir::OpCode::LOAD_INDEX: {
+                    int64_t elem_slots = READ_UINT16();
+                    int64_t index = pop().i64_value();
+                    Value base = pop();
+                    if (base.i64_value() == 0)
+                        throw std::runtime_error("Null pointer dereference at ip " + std::to_string(CUR_CORO().ip));
+                    Value *elem = (Value *)(intptr_t)(base.i64_value() + index * elem_slots * sizeof(Value));
+                    push(*elem);
+                    break;
+                }
+
+                case ir::OpCode::INDEX_ADDR: {
+                    int64_t elem_slots = READ_UINT16();
+                    int64_t index = pop().i64_value();
+                    Value base = pop();
+                    push(Value((int64_t)(base.i64_value() + index * elem_slots * sizeof(Value))));
+                    break;
+                }
+
                 case ir::OpCode::STORE_PTR_OFFSET: {
                     int32_t offset = READ_I32();
                     Value ptr_val = pop();  // Pointer is popped AFTER values?
@@ -619,7 +795,9 @@ Value VM::run(bool collect_stats) {
                     if (!ptr_addr)
                         throw std::runtime_error("Null pointer dereference at ip " + std::to_string(CUR_CORO().ip));
                     Value *ptr = (Value *)ptr_addr;
-                    ptr[offset] = pop();
+                    Value value = pop();
+                    value.own();
+                    ptr[offset] = std::move(value);
                     break;
                 }
 
@@ -661,7 +839,55 @@ Value VM::run(bool collect_stats) {
             m_current_coro++;
         }
     }
+    // Nothing is running, so whatever garbage is left can go before control returns to the host
+    cycles.collect_all();
+    drain_output();
     return main_result;
 }
 
+Value VM::call(const ir::IRProgram::FunctionInfo &func, std::span<const Value> args) {
+    if (args.size() < func.num_params || args.size() > 0x7F) {
+        throw std::runtime_error("Function expects " + std::to_string(func.num_params) + " arguments, got " +
+                                 std::to_string(args.size()));
+    }
+    auto coro = std::make_unique<Coroutine>();
+    uint32_t id = m_next_coro_id++;
+    coro->id = id;
+    coro->ip = func.entry_addr;
+    coro->call_stack.push_back({0, 0, func.num_params, (uint8_t)args.size(), func.num_slots});
+    coro->stack.assign(args.begin(), args.end());
+    if (func.num_slots > args.size()) {
+        coro->stack.resize(func.num_slots);
+    }
+    coro->stack.reserve(65536);  // Prevent pointer invalidation
+    m_coroutines.push_back(std::move(coro));
+    m_current_coro = m_coroutines.size() - 1;
+
+    try {
+        run();
+    } catch (...) {
+        // Whatever was running is abandoned, so the next call starts from a clean scheduler
+        CycleCollector::Scope scope(*m_cycles);
+        m_coroutines.clear();
+        m_finished_coros.clear();
+        throw;
+    }
+    Value result;
+    auto it = m_finished_coros.find(id);
+    if (it != m_finished_coros.end()) {
+        result = std::move(it->second);
+        m_finished_coros.erase(it);
+    }
+    return result;
+}
+
+void VM::register_host_function(int64_t id, HostFunction fn) {
+    if (id < HostSyscallBase) {
+        throw std::runtime_error("Host function ids start at " + std::to_string(HostSyscallBase));
+    }
+    size_t index = (size_t)(id - HostSyscallBase);
+    if (index >= m_host_functions.size()) m_host_functions.resize(index + 1);
+    m_host_functions[index] = std::move(fn);
+}
+
 }  // namespace ether::vm
@@ -2,33 +2,43 @@
 #define ETHER_VM_HPP
 
 #include <liburing.h>
+#include <sys/socket.h>
 
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <memory>
 #include <new>
+#include <span>
 #include <stdexcept>
+#include <string>
 #include <string_view>
 #include <unordered_map>
 #include <vector>
 
+#include "format.hpp"
 #include "ir/ir.hpp"
+#include "output_channel.hpp"
+#include "timer_wheel.hpp"
 
 namespace ether::vm {
 
-enum class ValueType : uint8_t { I64, I32, I16, I8, F64, F32, String, Array, Ptr };
+enum class ValueType : uint8_t { I64, I32, I16, I8, F64, F32, String, Array, Ptr, Bytes };
 
 struct Value;
 
 struct StringObj {
     uint32_t ref_count;
     uint32_t len;
+    uint32_t pool_id;  // String pool entry this was loaded from, NoPoolId once created or modified at runtime
     char data[1];
 };
 
+constexpr uint32_t NoPoolId = UINT32_MAX;
+
 inline StringObj* string_obj_from_data(char* data) { return (StringObj*)((uint8_t*)data - offsetof(StringObj, data)); }
 
 inline char* alloc_string_data_len(size_t len) {
@@ -39,6 +49,7 @@ inline char* alloc_string_data_len(size_t len) {
     }
     obj->ref_count = 1;
     obj->len = static_cast<uint32_t>(len);
+    obj->pool_id = NoPoolId;
     obj->data[len] = '\0';
     return obj->data;
 }
@@ -65,6 +76,25 @@ inline void release_string_data(char* data) {
     }
 }
 
+// A read-only mapping of a file (see the mmap syscall). Every bytes value viewing it holds a reference and the last
+// one to go unmaps it. munmap unmaps it early and marks it closed, which makes the views still around fail when used.
+struct BytesObj {
+    uint32_t ref_count;
+    uint32_t len;
+    bool closed;
+    const char* data;
+};
+
+void free_bytes_obj(BytesObj* obj);
+
+inline void retain_bytes(BytesObj* obj) {
+    if (obj) obj->ref_count += 1;
+}
+
+inline void release_bytes(BytesObj* obj) {
+    if (obj && --obj->ref_count == 0) free_bytes_obj(obj);
+}
+
 struct ArrayObj;
 Value* alloc_array_data(size_t slots);
 void retain_array_data(Value* data);
@@ -72,6 +102,9 @@ void release_array_data(Value* data);
 
 struct Value {
     ValueType type;
+    // Set on operand stack copies of a local that still holds the reference, which skip the retain and release
+    // until stored somewhere that outlives the local (see own())
+    bool borrowed = false;
     uint32_t len;  // for string_view support
     union {
         int64_t i64;
@@ -82,7 +115,8 @@ struct Value {
         float f32;
         char* str;  // string_view representation
         Value* arr;
-        void* ptr;  // raw pointer for I/O buffers
+        void* ptr;          // raw pointer for I/O buffers
+        BytesObj* bytes;    // read-only mapped file, nullptr for an empty view
     } as;
 
     Value() : type(ValueType::I32) { as.i32 = 0; }
@@ -97,6 +131,14 @@ struct Value {
         as.str = alloc_string_data(v);
         len = static_cast<uint32_t>(v.size());
     }
+    // Takes over the reference `obj` was created with
+    static Value make_bytes(BytesObj* obj) {
+        Value v;
+        v.type = ValueType::Bytes;
+        v.as.bytes = obj;
+        v.len = 0;
+        return v;
+    }
     static Value make_array(Value* data, uint32_t slots) {
         Value v;
         v.type = ValueType::Array;
@@ -104,6 +146,27 @@ struct Value {
         v.len = slots;
         return v;
     }
+    // A copy of `other` that does not hold its own reference; `other` must outlive it or it must be own()ed first
+    static Value borrow(const Value& other) {
+        Value v;
+        v.type = other.type;
+        v.len = other.len;
+        v.as = other.as;
+        v.borrowed =
+            other.type == ValueType::String || other.type == ValueType::Array || other.type == ValueType::Bytes;
+        return v;
+    }
+    void own() {
+        if (!borrowed) return;
+        borrowed = false;
+        if (type == ValueType::String) {
+            retain_string_data(as.str);
+        } else if (type == ValueType::Array) {
+            retain_array_data(as.arr);
+        } else if (type == ValueType::Bytes) {
+            retain_bytes(as.bytes);
+        }
+    }
 
     Value(const Value& other) : type(other.type), len(other.len) {
         as = other.as;
@@ -111,11 +174,14 @@ struct Value {
             retain_string_data(as.str);
         } else if (type == ValueType::Array) {
             retain_array_data(as.arr);
+        } else if (type == ValueType::Bytes) {
+            retain_bytes(as.bytes);
         }
     }
 
-    Value(Value&& other) noexcept : type(other.type), len(other.len) {
+    Value(Value&& other) noexcept : type(other.type), borrowed(other.borrowed), len(other.len) {
         as = other.as;
+        other.borrowed = false;
         other.type = ValueType::I32;
         other.as.i32 = 0;
         other.len = 0;
@@ -123,37 +189,44 @@ struct Value {
 
     Value& operator=(const Value& other) {
         if (this == &other) return *this;
+        // Take the new reference before dropping the old one, which may be the last holder of the same object
+        if (other.type == ValueType::String) {
+            retain_string_data(other.as.str);
+        } else if (other.type == ValueType::Array) {
+            retain_array_data(other.as.arr);
+        } else if (other.type == ValueType::Bytes) {
+            retain_bytes(other.as.bytes);
+        }
+        drop();
         type = other.type;
+        borrowed = false;
         len = other.len;
         as = other.as;
-        if (type == ValueType::String) {
-            retain_string_data(as.str);
-        } else if (type == ValueType::Array) {
-            retain_array_data(as.arr);
-        }
         return *this;
     }
 
     Value& operator=(Value&& other) noexcept {
         if (this == &other) return *this;
+        drop();
         type = other.type;
+        borrowed = other.borrowed;
         len = other.len;
         as = other.as;
+        other.borrowed = false;
         other.type = ValueType::I32;
         other.as.i32 = 0;
         other.len = 0;
         return *this;
     }
 
-    ~Value() {
-        if (type == ValueType::String) {
-            release_string_data(as.str);
-        } else if (type == ValueType::Array) {
-            release_array_data(as.arr);
-        }
-    }
+    ~Value() { drop(); }
 
     std::string_view as_string() const { return std::string_view(as.str, len); }
+    // Empty once the mapping has been unmapped
+    std::string_view as_bytes() const {
+        if (!as.bytes || as.bytes->closed) return {};
+        return std::string_view(as.bytes->data, as.bytes->len);
+    }
 
     int64_t i64_value() const {
         switch (type) {
@@ -173,6 +246,8 @@ struct Value {
                 return (intptr_t)as.arr;
             case ValueType::Ptr:
                 return (intptr_t)as.ptr;
+            case ValueType::Bytes:
+                return (intptr_t)as_bytes().data();
             default:
                 return 0;
         }
@@ -196,14 +271,37 @@ struct Value {
                 return 0.0;
         }
     }
+
+   private:
+    // Gives up the reference this value holds, if any
+    void drop() {
+        if (borrowed) return;
+        if (type == ValueType::String) {
+            release_string_data(as.str);
+        } else if (type == ValueType::Array) {
+            release_array_data(as.arr);
+        } else if (type == ValueType::Bytes) {
+            release_bytes(as.bytes);
+        }
+    }
 };
 
+// Arrays (and the structs built on them) can point at each other, so reference counting alone leaks cycles. The
+// color and buffered flag belong to the cycle collector (see cycle_collector.hpp).
+enum class GcColor : uint8_t { Black, Gray, White, Purple };
+
 struct ArrayObj {
     uint32_t ref_count;
     uint32_t slots;
+    GcColor color;
+    bool buffered;
     Value data[1];
 };
 
+// Records an array whose count dropped without reaching zero with the running VM's collector, since only a cycle may
+// be keeping it alive now
+void buffer_possible_cycle_root(ArrayObj* obj);
+
 inline ArrayObj* array_obj_from_data(Value* data) { return (ArrayObj*)((uint8_t*)data - offsetof(ArrayObj, data)); }
 
 inline Value* alloc_array_data(size_t slots) {
@@ -214,6 +312,8 @@ inline Value* alloc_array_data(size_t slots) {
     }
     obj->ref_count = 1;
     obj->slots = static_cast<uint32_t>(slots);
+    obj->color = GcColor::Black;
+    obj->buffered = false;
     for (size_t i = 0; i < slots; ++i) {
         new (&obj->data[i]) Value();
     }
@@ -224,6 +324,7 @@ inline void retain_array_data(Value* data) {
     if (!data) return;
     auto* obj = array_obj_from_data(data);
     obj->ref_count += 1;
+    obj->color = GcColor::Black;
 }
 
 inline void release_array_data(Value* data) {
@@ -233,7 +334,12 @@ inline void release_array_data(Value* data) {
         for (size_t i = 0; i < obj->slots; ++i) {
             obj->data[i].~Value();
         }
-        free(obj);
+        obj->color = GcColor::Black;
+        // A buffered candidate is freed by the collector once it drops the pointer
+        if (!obj->buffered) free(obj);
+    } else if (obj->color != GcColor::Purple) {
+        obj->color = GcColor::Purple;
+        if (!obj->buffered) buffer_possible_cycle_root(obj);
     }
 }
 // Asssegure that Value is 16 bytes
@@ -268,20 +374,55 @@ inline std::ostream& operator<<(std::ostream& os, const Value& val) {
         case ValueType::Ptr:
             os << val.as.ptr;
             break;
+        case ValueType::Bytes:
+            os << val.as_bytes();
+            break;
     }
     return os;
 }
 
+class CycleCollector;
+
 struct OpCodeStats {
     uint64_t count = 0;
     std::chrono::nanoseconds total_time{0};
 };
 
+// Storage for the locals FRAME_ALLOC places in a frame. It is kept apart from the coroutine's value stack, which
+// moves when it grows, so a pointer into it stays valid for as long as its frame lives. Memory comes in chunks that
+// never move, and is given back in LIFO order as frames return.
+class FrameArena {
+   public:
+    struct Mark {
+        size_t chunk = 0;
+        size_t used = 0;
+    };
+
+    Mark mark() const { return {m_current, m_chunks.empty() ? 0 : m_chunks[m_current].used}; }
+    Value* allocate(size_t count);
+    // Frees everything allocated since `mark`, dropping the references it held
+    void release(Mark mark);
+
+   private:
+    static constexpr size_t ChunkSize = 4096;
+    struct Chunk {
+        std::unique_ptr<Value[]> data;
+        size_t size;
+        size_t used = 0;
+    };
+    std::vector<Chunk> m_chunks;
+    size_t m_current = 0;  // Chunks after it are empty
+};
+
 struct CallFrame {
     size_t return_addr;
     size_t stack_base;  // offset in m_stack where locals start
     uint8_t num_fixed_params;
     uint8_t num_args_passed;
+    uint32_t num_slots = 0;
+    // The frame's slots in the coroutine's FrameArena, taken on its first FRAME_ALLOC
+    Value* frame_data = nullptr;
+    FrameArena::Mark arena_mark{};
 };
 
 struct Coroutine {
@@ -290,6 +431,7 @@ struct Coroutine {
     bool waiting_for_io = false;  // Flag for I/O wait
     std::vector<Value> stack;
     std::vector<CallFrame> call_stack;
+    FrameArena frame_arena;
     size_t ip;
     Value result;
     std::vector<uint8_t> io_buffer;   // For holding temporary data (like sockaddr) during async I/O
@@ -312,32 +454,115 @@ struct Coroutine {
     }
 };
 
+// How a syscall handler left the call: with a result, parked until the scheduler wakes the coroutine with one, or
+// handed to the ring
+enum class SyscallStatus : uint8_t { Done, Parked, Submit };
+
+// Parsed socket address, cached per address string so connect/bind never re-parse the same text.
+struct SockAddr {
+    struct sockaddr_storage storage;
+    socklen_t len;
+};
+
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+// A native function provided by the program embedding the VM. Scripts reach it with syscall(id, args...) for the id
+// it was registered under, which must be at least HostSyscallBase; the id itself is not passed in `args`.
+using HostFunction = std::function<Value(std::span<const Value> args)>;
+constexpr int64_t HostSyscallBase = 1000;
+
+struct VMOptions {
+    OutputPolicy output_policy = OutputPolicy::Block;
+    size_t output_buffer = 1024 * 1024;  // Bytes of console output queued per stream before the policy applies
+};
+
 class VM {
    public:
-    explicit VM(const ir::IRProgram& program);
+    explicit VM(const ir::ProgramView& program, const VMOptions& options = {});
+    explicit VM(const ir::IRProgram& program, const VMOptions& options = {})
+        : VM(ir::ProgramView::of(program), options) {}
     ~VM();
     Value run(bool collect_stats = false);
+    // Runs a function to completion on a new coroutine, along with anything it spawns, and returns its result
+    Value call(const ir::IRProgram::FunctionInfo& func, std::span<const Value> args);
+    void register_host_function(int64_t id, HostFunction fn);
 
     const std::unordered_map<ir::OpCode, OpCodeStats>& get_stats() const { return m_stats; }
+    uint64_t output_dropped() const { return m_stdout.dropped() + m_stderr.dropped(); }
+    // Arrays the cycle collector has freed so far
+    size_t cycles_freed() const;
 
    private:
-    const ir::IRProgram& program_;
+    ir::ProgramView program_;
     std::vector<std::unique_ptr<Coroutine>> m_coroutines;
     std::vector<Value> m_globals;
     size_t m_current_coro = 0;
     uint32_t m_next_coro_id = 1;
     std::unordered_map<uint32_t, Value> m_finished_coros;
     std::unordered_map<ir::OpCode, OpCodeStats> m_stats;
+    std::vector<HostFunction> m_host_functions;  // Indexed by syscall id minus HostSyscallBase
+    std::unique_ptr<CycleCollector> m_cycles;
 
     struct io_uring m_ring;
 
+    // Sleeps are kept in a VM-side wheel; only the nearest deadline is armed in the ring as a single timeout.
+    TimerWheel m_timers;
+    struct __kernel_timespec m_timer_ts;
+    uint64_t m_timer_generation = 0;
+    uint64_t m_timer_deadline = 0;
+    bool m_timer_armed = false;
+
+    // Socket setup ops the running kernel can execute in the ring; otherwise they run synchronously.
+    bool m_ring_socket = false;
+    bool m_ring_bind = false;
+    bool m_ring_listen = false;
+    std::unordered_map<std::string, SockAddr, StringHash, std::equal_to<>> m_addr_cache;
+
+    // Console output (printf and writes to fd 1/2) is batched here and written through the ring, so a slow reader
+    // only ever parks the coroutine that is writing.
+    OutputChannel m_stdout;
+    OutputChannel m_stderr;
+    OutputPolicy m_output_policy;
+    struct OutputWaiter {
+        uint32_t coro_id;
+        OutputChannel* channel;
+        int32_t result;
+    };
+    std::vector<OutputWaiter> m_output_waiters;
+    // Format strings from the string pool are compiled once, indexed by pool id.
+    std::vector<std::unique_ptr<CompiledFormat>> m_format_cache;
+    CompiledFormat m_format_scratch;
+    FloatFormat m_float_format;
+    std::string m_format_buffer;
+
+    // user_data tags for ring entries that do not belong to a coroutine. Coroutine ids only use the low 32 bits.
+    static constexpr uint64_t TimerTag = 1ull << 63;   // The wheel's wake-up timeout, low bits hold its generation
+    static constexpr uint64_t IgnoredTag = 1ull << 62;  // Linked timeouts and timeout removals
+    static constexpr uint64_t OutputTag = 1ull << 61;   // Console writes, low bits hold the fd
+
     void handle_io_completion();
+    void drain_output();
+    SyscallStatus console_write(Coroutine& coro, OutputChannel& channel, std::string_view data, int32_t result,
+                                Value& out);
+    void wake_output_waiters();
+    const CompiledFormat& format_for(const Value& fmt);
+    // Built-in syscalls run from a handler table indexed like ir::Syscalls, defined in vm_syscalls.cpp
+    friend struct SyscallTable;
     void submit_syscall(Coroutine& coro, uint8_t num_args);
+    void run_syscall(Coroutine& coro, size_t index, size_t num_args, size_t extra_pops);
+    void complete_io(uint32_t coro_id, int32_t res);
+    void expire_timers();
+    void arm_timer();
+    void probe_ring_ops();
+    const SockAddr* resolve_address(std::string_view text);
 
     inline void push(Value val) { m_coroutines[m_current_coro]->stack.push_back(std::move(val)); }
     inline Value pop() {
         auto& coro = m_coroutines[m_current_coro];
-        Value val = coro->stack.back();
+        Value val = std::move(coro->stack.back());
         coro->stack.pop_back();
         return val;
     }
@@ -1,257 +1,576 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <unistd.h>
 
+#include <cerrno>
+#include <cstddef>
 #include <cstring>
 #include <iostream>
+#include <iterator>
 
+#include "ir/syscalls.hpp"
 #include "vm.hpp"
 
 namespace ether::vm {
 
+void free_bytes_obj(BytesObj *obj) {
+    if (!obj->closed) ::munmap((void *)obj->data, obj->len);
+    delete obj;
+}
+
+static void set_timespec(struct __kernel_timespec &ts, int64_t ms) {
+    if (ms < 0) ms = 0;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+}
+
+void VM::probe_ring_ops() {
+    struct io_uring_probe *probe = io_uring_get_probe_ring(&m_ring);
+    if (!probe) return;
+#ifdef IO_URING_CHECK_VERSION
+    m_ring_socket = io_uring_opcode_supported(probe, IORING_OP_SOCKET);
+#if !IO_URING_CHECK_VERSION(2, 8)
+    m_ring_bind = io_uring_opcode_supported(probe, IORING_OP_BIND);
+    m_ring_listen = io_uring_opcode_supported(probe, IORING_OP_LISTEN);
+#endif
+#endif
+    io_uring_free_probe(probe);
+}
+
+// Accepts "a.b.c.d", an IPv6 literal (optionally bracketed), "unix:/path" and "unix:@name" for the abstract
+// namespace. Nothing here resolves names, so it never blocks.
+static bool parse_sockaddr(std::string_view text, SockAddr &out) {
+    memset(&out.storage, 0, sizeof(out.storage));
+    if (text.starts_with("unix:")) {
+        text.remove_prefix(5);
+        auto *addr = (struct sockaddr_un *)&out.storage;
+        if (text.empty() || text.size() >= sizeof(addr->sun_path)) return false;
+        addr->sun_family = AF_UNIX;
+        memcpy(addr->sun_path, text.data(), text.size());
+        if (text[0] == '@') {
+            addr->sun_path[0] = '\0';
+            out.len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + text.size());
+        } else {
+            out.len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + text.size() + 1);
+        }
+        return true;
+    }
+
+    if (text.size() >= 2 && text.front() == '[' && text.back() == ']') {
+        text = text.substr(1, text.size() - 2);
+    }
+    char buf[INET6_ADDRSTRLEN];
+    if (text.size() >= sizeof(buf)) return false;
+    memcpy(buf, text.data(), text.size());
+    buf[text.size()] = '\0';
+
+    if (text.find(':') != std::string_view::npos) {
+        auto *addr = (struct sockaddr_in6 *)&out.storage;
+        addr->sin6_family = AF_INET6;
+        out.len = sizeof(struct sockaddr_in6);
+        return inet_pton(AF_INET6, buf, &addr->sin6_addr) == 1;
+    }
+    auto *addr = (struct sockaddr_in *)&out.storage;
+    addr->sin_family = AF_INET;
+    out.len = sizeof(struct sockaddr_in);
+    return inet_pton(AF_INET, buf, &addr->sin_addr) == 1;
+}
+
+const SockAddr *VM::resolve_address(std::string_view text) {
+    auto it = m_addr_cache.find(text);
+    if (it != m_addr_cache.end()) return &it->second;
+
+    SockAddr addr;
+    if (!parse_sockaddr(text, addr)) return nullptr;
+    if (m_addr_cache.size() >= 1024) m_addr_cache.clear();
+    return &m_addr_cache.emplace(std::string(text), addr).first->second;
+}
+
+// Copies a cached address into the coroutine's I/O buffer, which stays alive until the operation completes.
+// Its size is the address length.
+static void stage_sockaddr(Coroutine &coro, const SockAddr &addr, int port) {
+    auto *bytes = (const uint8_t *)&addr.storage;
+    coro.io_buffer.assign(bytes, bytes + addr.len);
+    auto *sa = (struct sockaddr *)coro.io_buffer.data();
+    if (sa->sa_family == AF_INET) {
+        ((struct sockaddr_in *)sa)->sin_port = htons(port);
+    } else if (sa->sa_family == AF_INET6) {
+        ((struct sockaddr_in6 *)sa)->sin6_port = htons(port);
+    }
+}
+
+const CompiledFormat &VM::format_for(const Value &fmt) {
+    uint32_t pool_id = string_obj_from_data(fmt.as.str)->pool_id;
+    if (pool_id == NoPoolId) {
+        // Built at runtime, so there is nothing stable to key on
+        m_format_scratch = compile_format(fmt.as_string());
+        return m_format_scratch;
+    }
+    if (pool_id >= m_format_cache.size()) {
+        m_format_cache.resize(program_.string_pool.size());
+    }
+    auto &entry = m_format_cache[pool_id];
+    if (!entry) {
+        entry = std::make_unique<CompiledFormat>(compile_format(fmt.as_string()));
+    }
+    return *entry;
+}
+
+// Blocks until all buffered console output has been written.
+void VM::drain_output() {
+    m_stdout.flush();
+    m_stderr.flush();
+    while (!m_stdout.empty() || !m_stderr.empty()) {
+        struct io_uring_cqe *cqe;
+        if (io_uring_wait_cqe(&m_ring, &cqe) < 0) break;
+        handle_io_completion();
+        m_stdout.flush();
+        m_stderr.flush();
+    }
+}
+
+// Queues console output under the configured policy. `result` is what the syscall returns once the data is accepted.
+SyscallStatus VM::console_write(Coroutine &coro, OutputChannel &channel, std::string_view data, int32_t result,
+                                Value &out) {
+    if (m_output_policy == OutputPolicy::Drop && !channel.has_room(data.size())) {
+        channel.count_dropped(data.size());
+        out = Value(-EAGAIN);
+        return SyscallStatus::Done;
+    }
+    channel.write(data);
+    if (m_output_policy == OutputPolicy::Block && channel.over_limit()) {
+        channel.flush();
+        coro.waiting_for_io = true;
+        m_output_waiters.push_back({coro.id, &channel, result});
+        return SyscallStatus::Parked;
+    }
+    out = Value(result);
+    return SyscallStatus::Done;
+}
+
+void VM::wake_output_waiters() {
+    std::erase_if(m_output_waiters, [&](const OutputWaiter &waiter) {
+        if (waiter.channel->over_limit()) return false;
+        complete_io(waiter.coro_id, waiter.result);
+        return true;
+    });
+}
+
 void VM::handle_io_completion() {
     struct io_uring_cqe *cqe;
     while (io_uring_peek_cqe(&m_ring, &cqe) == 0) {
-        uint32_t coro_id = (uint32_t)(uintptr_t)io_uring_cqe_get_data(cqe);
+        uint64_t data = (uint64_t)(uintptr_t)io_uring_cqe_get_data(cqe);
         int32_t res = cqe->res;
         io_uring_cqe_seen(&m_ring, cqe);
 
-        for (auto &coro : m_coroutines) {
-            if (coro->id == coro_id) {
-                coro->stack.push_back(Value(res));
-                coro->waiting_for_io = false;
-                coro->pending_args.clear();
-                if (coro->ip == 0xFFFFFFFF) {
-                    // It was a spawned native call, mark it as finished
-                    coro->result = res;
-                    coro->finished = true;
-                }
-                break;
+        if (data & TimerTag) {
+            if ((data & ~TimerTag) == m_timer_generation) {
+                m_timer_armed = false;
             }
+            continue;
+        }
+        if (data & IgnoredTag) {
+            continue;
+        }
+        if (data & OutputTag) {
+            (data == m_stderr.user_data() ? m_stderr : m_stdout).on_complete(res);
+            wake_output_waiters();
+            continue;
         }
+        complete_io((uint32_t)data, res);
     }
+    // Completions free up the ring, so a console write that found it full can go now
+    m_stdout.resubmit();
+    m_stderr.resubmit();
+    expire_timers();
 }
 
-void VM::submit_syscall(Coroutine &coro, uint8_t num_args) {
-    auto &stack = coro.stack;
-    std::vector<Value> args(num_args);
-    for (int i = num_args - 1; i >= 0; --i) {
-        args[i] = stack.back();
-        stack.pop_back();
+void VM::complete_io(uint32_t coro_id, int32_t res) {
+    for (auto &coro : m_coroutines) {
+        if (coro->id == coro_id) {
+            coro->stack.push_back(Value(res));
+            coro->waiting_for_io = false;
+            coro->pending_args.clear();
+            if (coro->ip == 0xFFFFFFFF) {
+                // It was a spawned native call, mark it as finished
+                coro->result = res;
+                coro->finished = true;
+            }
+            break;
+        }
     }
+}
 
-    if (args.empty()) {
-        coro.stack.push_back(Value(-1));
-        return;
+void VM::expire_timers() {
+    if (m_timers.empty()) return;
+    // A sleep completes like the IORING_OP_TIMEOUT it replaces: with -ETIME.
+    m_timers.advance(TimerWheel::now_ms(), [this](uint32_t coro_id) { complete_io(coro_id, -ETIME); });
+    arm_timer();
+}
+
+void VM::arm_timer() {
+    auto next = m_timers.next_deadline();
+    if (!next) return;
+    if (m_timer_armed && m_timer_deadline <= *next) return;
+
+    if (io_uring_sq_space_left(&m_ring) < 2) {
+        io_uring_submit(&m_ring);
     }
+    struct io_uring_sqe *sqe;
+    if (m_timer_armed) {
+        sqe = io_uring_get_sqe(&m_ring);
+        io_uring_prep_timeout_remove(sqe, TimerTag | m_timer_generation, 0);
+        io_uring_sqe_set_data(sqe, (void *)(uintptr_t)IgnoredTag);
+    }
+    sqe = io_uring_get_sqe(&m_ring);
+    uint64_t now = TimerWheel::now_ms();
+    set_timespec(m_timer_ts, *next > now ? (int64_t)(*next - now) : 0);
+    m_timer_generation++;
+    io_uring_prep_timeout(sqe, &m_timer_ts, 0, 0);
+    io_uring_sqe_set_data(sqe, (void *)(uintptr_t)(TimerTag | m_timer_generation));
+    io_uring_submit(&m_ring);
+    m_timer_armed = true;
+    m_timer_deadline = *next;
+}
 
-    int64_t id = args[0].i64_value();
+namespace {
 
-    switch (id) {
-        case 10: {  // PRINTF
-            if (args.size() < 2 || args[1].type != ValueType::String) {
-                throw std::runtime_error("printf requires at least a format string argument");
-            }
+using Args = std::span<Value>;
+using PendingArgs = std::span<const Value>;
 
-            std::string_view fmt = args[1].as_string();
-            size_t arg_idx = 2;
-            for (size_t i = 0; i < fmt.size(); ++i) {
-                if (fmt[i] == '%' && i + 1 < fmt.size()) {
-                    i++;
-                    int precision = -1;
-                    if (fmt[i] == '.') {
-                        i++;
-                        while (fmt[i] >= '0' && fmt[i] <= '9') {
-                            if (precision == -1) {
-                                precision = 0;
-                            }
-                            precision = precision * 10 + (fmt[i] - '0');
-                            i++;
-                        }
-                    }
-                    if (fmt[i] == 'd') {
-                        if (arg_idx < args.size() &&
-                            (args[arg_idx].type == ValueType::I64 || args[arg_idx].type == ValueType::I32 ||
-                             args[arg_idx].type == ValueType::I16 || args[arg_idx].type == ValueType::I8)) {
-                            std::cout << args[arg_idx++].i64_value();
-                        } else {
-                            std::cout << "%d";
-                        }
-                    } else if (fmt[i] == 'f') {
-                        if (arg_idx < args.size() && args[arg_idx].type == ValueType::F64 ||
-                            args[arg_idx].type == ValueType::F32) {
-                            if (precision != -1) {
-                                std::cout << std::fixed << std::setprecision(precision);
-                            }
-                            std::cout << args[arg_idx++].f64_value();
-                        } else {
-                            std::cout << "%f";
-                        }
-                    } else if (fmt[i] == 's') {
-                        if (arg_idx < args.size() && args[arg_idx].type == ValueType::String) {
-                            std::cout << args[arg_idx++].as_string();
-                        } else {
-                            std::cout << "%s";
-                        }
-                    } else if (fmt[i] == 'p') {
-                        if (arg_idx < args.size() && args[arg_idx].type == ValueType::Ptr) {
-                            std::cout << args[arg_idx++].as.ptr;
-                        } else {
-                            std::cout << "%p";
-                        }
-                    } else {
-                        std::cout << '%' << fmt[i];
-                    }
-                } else if (fmt[i] == '\\' && i + 1 < fmt.size()) {
-                    i++;
-                    if (fmt[i] == 'n')
-                        std::cout << '\n';
-                    else if (fmt[i] == 't')
-                        std::cout << '\t';
-                    else
-                        std::cout << '\\' << fmt[i];
-                } else {
-                    std::cout << fmt[i];
-                }
-            }
-            std::cout << std::flush;
-            coro.stack.push_back(Value(0));
-            return;
-        }
+const void *buffer_of(const Value &value) {
+    if (value.type == ValueType::Bytes) return value.as_bytes().data();
+    return value.type == ValueType::String ? (const void *)value.as.str : value.as.ptr;
+}
 
-        case 16: {  // STRLEN
-            if (args.size() < 2 || args[1].type != ValueType::String) {
-                throw std::runtime_error("strlen requires a string argument");
-            }
-            coro.stack.push_back(Value((int32_t)args[1].len));
-            return;
+bool accepts(ir::SyscallArg kind, ValueType type) {
+    switch (kind) {
+        case ir::SyscallArg::Any:
+            return true;
+        case ir::SyscallArg::Int:
+            return type == ValueType::I64 || type == ValueType::I32 || type == ValueType::I16 || type == ValueType::I8;
+        case ir::SyscallArg::String:
+            return type == ValueType::String;
+        case ir::SyscallArg::Bytes:
+            return type == ValueType::Bytes;
+        case ir::SyscallArg::Text:
+            return type == ValueType::String || type == ValueType::Bytes;
+        case ir::SyscallArg::Buffer:
+            return type == ValueType::String || type == ValueType::Bytes || type == ValueType::Ptr ||
+                   type == ValueType::Array;
+    }
+    return false;
+}
+
+// The analyzer has already done this for syscalls with a constant id
+void check_args(const ir::SyscallSignature &sig, std::span<const Value> args) {
+    bool variadic = sig.max_args == ir::SyscallSignature::VariadicArgs;
+    if (args.size() < sig.min_args || (!variadic && args.size() > sig.max_args)) {
+        throw std::runtime_error("Wrong number of arguments for syscall " + std::string(sig.name));
+    }
+    for (size_t i = 0; i < args.size() && i < sig.args.size(); ++i) {
+        if (!accepts(sig.arg(i), args[i].type)) {
+            throw std::runtime_error("Invalid argument " + std::to_string(i + 1) + " for syscall " +
+                                     std::string(sig.name));
         }
+    }
+}
+
+}  // namespace
+
+// The built-in syscalls. `run` executes a syscall on the spot, or returns Submit to hand it to the ring through
+// `prep`; a syscall without `run` always goes to the ring. Arguments are read in place from the coroutine's stack,
+// except that `prep` sees the copy kept alive in pending_args until the operation completes.
+struct SyscallTable {
+    struct Handler {
+        SyscallStatus (*run)(VM &vm, Coroutine &coro, Args args, Value &result);
+        void (*prep)(VM &vm, Coroutine &coro, PendingArgs args, struct io_uring_sqe *sqe);
+        int8_t deadline_arg;  // Optional trailing deadline in ms for operations that may wait on a peer, or -1
+    };
+    static const Handler Handlers[];
+
+    static SyscallStatus printf(VM &vm, Coroutine &coro, Args args, Value &result) {
+        vm.m_format_buffer.clear();
+        render_format(vm.format_for(args[0]), args.data() + 1, args.size() - 1, vm.m_float_format,
+                      vm.m_format_buffer);
+        return vm.console_write(coro, vm.m_stdout, vm.m_format_buffer, 0, result);
+    }
+
+    static SyscallStatus strlen(VM &, Coroutine &, Args args, Value &result) {
+        result = Value((int32_t)(args[0].type == ValueType::Bytes ? args[0].as_bytes().size() : args[0].len));
+        return SyscallStatus::Done;
+    }
 
-        case 13: {  // SOCKET
-            int domain = (int)args[1].i64_value();
-            int type = (int)args[2].i64_value();
-            int protocol = (int)args[3].i64_value();
-            int fd = socket(domain, type, protocol);
-            coro.stack.push_back(Value(fd));
-            return;
+    static SyscallStatus mmap(VM &, Coroutine &, Args args, Value &result) {
+        int advice = (int)args[1].i64_value();
+        result = Value::make_bytes(nullptr);
+        int fd = open(args[0].as.str, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return SyscallStatus::Done;
+        struct stat st;
+        if (fstat(fd, &st) < 0 || st.st_size == 0) {
+            close(fd);
+            return SyscallStatus::Done;
         }
-        case 14: {  // BIND
-            int fd = (int)args[1].i64_value();
-            int port = (int)args[2].i64_value();
-            struct sockaddr_in addr;
-            memset(&addr, 0, sizeof(addr));
-            addr.sin_family = AF_INET;
-            addr.sin_port = htons(port);
-            addr.sin_addr.s_addr = INADDR_ANY;
-            int res = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
-            coro.stack.push_back(Value(res));
-            return;
+        if ((uint64_t)st.st_size > UINT32_MAX) {
+            close(fd);
+            throw std::runtime_error("mmap: file too large for a bytes view");
         }
-        case 15: {  // LISTEN
-            int fd = (int)args[1].i64_value();
-            int backlog = (int)args[2].i64_value();
-            int res = listen(fd, backlog);
-            coro.stack.push_back(Value(res));
-            return;
+        void *data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) return SyscallStatus::Done;
+        if (advice != MADV_NORMAL) {
+            ::madvise(data, st.st_size, advice);
         }
+        result = Value::make_bytes(new BytesObj{1, (uint32_t)st.st_size, false, (const char *)data});
+        return SyscallStatus::Done;
+    }
 
-        default:
-            break;  // Continue to async syscalls
+    // Unmaps now rather than when the last view goes; the views left over fail when indexed
+    static SyscallStatus munmap(VM &, Coroutine &, Args args, Value &result) {
+        int res = 0;
+        BytesObj *view = args[0].as.bytes;
+        if (view && !view->closed) {
+            res = ::munmap((void *)view->data, view->len) < 0 ? -errno : 0;
+            view->closed = true;
+        }
+        result = Value(res);
+        return SyscallStatus::Done;
     }
 
-    // Async I/O syscalls
-    struct io_uring_sqe *sqe = io_uring_get_sqe(&m_ring);
-    if (!sqe) {
-        coro.stack.push_back(Value(-1));
-        return;
+    static SyscallStatus madvise(VM &, Coroutine &, Args args, Value &result) {
+        int res = 0;
+        std::string_view view = args[0].as_bytes();
+        if (!view.empty()) {
+            res = ::madvise((void *)view.data(), view.size(), (int)args[1].i64_value()) < 0 ? -errno : 0;
+        }
+        result = Value(res);
+        return SyscallStatus::Done;
     }
 
-    coro.pending_args = std::move(args);
-    auto &args_ref = coro.pending_args;
+    static SyscallStatus socket(VM &vm, Coroutine &, Args args, Value &result) {
+        if (vm.m_ring_socket) return SyscallStatus::Submit;
+        int fd = ::socket((int)args[0].i64_value(), (int)args[1].i64_value(), (int)args[2].i64_value());
+        result = Value(fd < 0 ? -errno : fd);
+        return SyscallStatus::Done;
+    }
 
-    switch (id) {
-        case 0: {  // OPEN
-            const char *path = args_ref[2].as.str;
-            int flags = (int)args_ref[3].i64_value();
-            int mode = (int)args_ref[4].i64_value();
-            io_uring_prep_openat(sqe, AT_FDCWD, path, flags, mode);
-            break;
-        }
-        case 1: {  // READ
-            int fd = (int)args_ref[1].i64_value();
-            void *buf = args_ref[2].as.ptr;
-            int size = (int)args_ref[3].i64_value();
-            io_uring_prep_read(sqe, fd, buf, size, 0);
-            break;
+    static SyscallStatus bind(VM &vm, Coroutine &coro, Args args, Value &result) {
+        // bind(fd, port) binds the IPv4 wildcard address, bind(fd, address, port) an explicit one
+        bool explicit_addr = args.size() > 2 && args[1].type == ValueType::String;
+        const SockAddr *addr = vm.resolve_address(explicit_addr ? args[1].as_string() : "0.0.0.0");
+        if (!addr) {
+            result = Value(-EINVAL);
+            return SyscallStatus::Done;
         }
-        case 2: {  // WRITE
-            int fd = (int)args_ref[1].i64_value();
-            const char *buf =
-                (args_ref[2].type == ValueType::String) ? args_ref[2].as.str : (const char *)args_ref[2].as.ptr;
-            int size = (int)args_ref[3].i64_value();
-            io_uring_prep_write(sqe, fd, buf, size, 0);
-            break;
-        }
-        case 3: {  // CLOSE
-            int fd = (int)args_ref[1].i64_value();
-            io_uring_prep_close(sqe, fd);
-            break;
+        stage_sockaddr(coro, *addr, (int)args[explicit_addr ? 2 : 1].i64_value());
+        if (vm.m_ring_bind) return SyscallStatus::Submit;
+        int res = ::bind((int)args[0].i64_value(), (struct sockaddr *)coro.io_buffer.data(), coro.io_buffer.size());
+        result = Value(res < 0 ? -errno : 0);
+        return SyscallStatus::Done;
+    }
+
+    // A bad address fails here, before an SQE is taken
+    static SyscallStatus connect(VM &vm, Coroutine &coro, Args args, Value &result) {
+        const SockAddr *addr = vm.resolve_address(args[1].as_string());
+        if (!addr) {
+            result = Value(-EINVAL);
+            return SyscallStatus::Done;
         }
-        case 4: {  // SLEEP
-            int32_t ms = (int32_t)args_ref[1].i64_value();
-            coro.timeout.tv_sec = ms / 1000;
-            coro.timeout.tv_nsec = (ms % 1000) * 1000000;
-            io_uring_prep_timeout(sqe, &coro.timeout, 0, 0);
-            break;
+        stage_sockaddr(coro, *addr, (int)args[2].i64_value());
+        return SyscallStatus::Submit;
+    }
+
+    static SyscallStatus listen(VM &vm, Coroutine &, Args args, Value &result) {
+        if (vm.m_ring_listen) return SyscallStatus::Submit;
+        int res = ::listen((int)args[0].i64_value(), (int)args[1].i64_value());
+        result = Value(res < 0 ? -errno : 0);
+        return SyscallStatus::Done;
+    }
+
+    // Console writes share printf's queue, which keeps them ordered and subject to the output policy
+    static SyscallStatus write(VM &vm, Coroutine &coro, Args args, Value &result) {
+        int64_t fd = args[0].i64_value();
+        if (fd != STDOUT_FILENO && fd != STDERR_FILENO) return SyscallStatus::Submit;
+        int64_t size = args[2].i64_value();
+        const char *buf = (const char *)buffer_of(args[1]);
+        if (args[1].type == ValueType::String && size > args[1].len) size = args[1].len;
+        if (args[1].type == ValueType::Bytes && size > (int64_t)args[1].as_bytes().size()) {
+            size = args[1].as_bytes().size();
         }
-        case 5: {  // ACCEPT
-            int fd = (int)args_ref[1].i64_value();
-            io_uring_prep_accept(sqe, fd, NULL, NULL, 0);
-            break;
+        if (!buf || size <= 0) {
+            result = Value(0);
+            return SyscallStatus::Done;
         }
-        case 6: {  // CONNECT
-            int fd = (int)args_ref[1].i64_value();
-            std::string ip_str(args_ref[2].as_string());
-            int port = (int)args_ref[3].i64_value();
-
-            coro.io_buffer.resize(sizeof(struct sockaddr_in));
-            struct sockaddr_in *addr = (struct sockaddr_in *)coro.io_buffer.data();
-            memset(addr, 0, sizeof(struct sockaddr_in));
-            addr->sin_family = AF_INET;
-            addr->sin_port = htons(port);
-            inet_pton(AF_INET, ip_str.c_str(), &addr->sin_addr);
-
-            io_uring_prep_connect(sqe, fd, (struct sockaddr *)addr, sizeof(struct sockaddr_in));
-            break;
+        return vm.console_write(coro, fd == STDOUT_FILENO ? vm.m_stdout : vm.m_stderr, std::string_view(buf, size),
+                                (int32_t)size, result);
+    }
+
+    static SyscallStatus sleep(VM &vm, Coroutine &coro, Args args, Value &) {
+        int64_t ms = args[0].i64_value();
+        vm.m_timers.schedule(TimerWheel::now_ms() + (ms > 0 ? ms : 0), coro.id);
+        coro.waiting_for_io = true;
+        vm.arm_timer();
+        return SyscallStatus::Parked;
+    }
+
+    static void prep_open(VM &, Coroutine &, PendingArgs args, struct io_uring_sqe *sqe) {
+        io_uring_prep_openat(sqe, AT_FDCWD, args[1].as.str, (int)args[2].i64_value(), (int)args[3].i64_value());
+    }
+
+    static void prep_read(VM &, Coroutine &, PendingArgs args, struct io_uring_sqe *sqe) {
+        io_uring_prep_read(sqe, (int)args[0].i64_value(), args[1].as.ptr, (int)args[2].i64_value(), 0);
+    }
+
+    static void prep_write(VM &, Coroutine &, PendingArgs args, struct io_uring_sqe *sqe) {
+        io_uring_prep_write(sqe, (int)args[0].i64_value(), buffer_of(args[1]), (int)args[2].i64_value(), 0);
+    }
+
+    static void prep_close(VM &, Coroutine &, PendingArgs args, struct io_uring_sqe *sqe) {
+        io_uring_prep_close(sqe, (int)args[0].i64_value());
+    }
+
+    static void prep_accept(VM &, Coroutine &, PendingArgs args, struct io_uring_sqe *sqe) {
+        io_uring_prep_accept(sqe, (int)args[0].i64_value(), NULL, NULL, 0);
+    }
+
+    // The address is already staged in io_buffer
+    static void prep_connect(VM &, Coroutine &coro, PendingArgs args, struct io_uring_sqe *sqe) {
+        io_uring_prep_connect(sqe, (int)args[0].i64_value(), (struct sockaddr *)coro.io_buffer.data(),
+                              coro.io_buffer.size());
+    }
+
+    static void prep_send(VM &, Coroutine &, PendingArgs args, struct io_uring_sqe *sqe) {
+        io_uring_prep_send(sqe, (int)args[0].i64_value(), buffer_of(args[1]), (int)args[2].i64_value(),
+                           (int)args[3].i64_value());
+    }
+
+    static void prep_recv(VM &, Coroutine &, PendingArgs args, struct io_uring_sqe *sqe) {
+        io_uring_prep_recv(sqe, (int)args[0].i64_value(), args[1].as.ptr, (int)args[2].i64_value(),
+                           (int)args[3].i64_value());
+    }
+
+#ifdef IO_URING_CHECK_VERSION
+    static void prep_socket(VM &, Coroutine &, PendingArgs args, struct io_uring_sqe *sqe) {
+        io_uring_prep_socket(sqe, (int)args[0].i64_value(), (int)args[1].i64_value(), (int)args[2].i64_value(), 0);
+    }
+#else
+    static constexpr auto prep_socket = nullptr;
+#endif
+
+#if defined(IO_URING_CHECK_VERSION) && !IO_URING_CHECK_VERSION(2, 8)
+    // The address is already staged in io_buffer
+    static void prep_bind(VM &, Coroutine &coro, PendingArgs args, struct io_uring_sqe *sqe) {
+        io_uring_prep_bind(sqe, (int)args[0].i64_value(), (struct sockaddr *)coro.io_buffer.data(),
+                           coro.io_buffer.size());
+    }
+
+    static void prep_listen(VM &, Coroutine &, PendingArgs args, struct io_uring_sqe *sqe) {
+        io_uring_prep_listen(sqe, (int)args[0].i64_value(), (int)args[1].i64_value());
+    }
+#else
+    static constexpr auto prep_bind = nullptr;
+    static constexpr auto prep_listen = nullptr;
+#endif
+};
+
+// Indexed like ir::Syscalls
+const SyscallTable::Handler SyscallTable::Handlers[] = {
+    {nullptr, prep_open, -1},    // open
+    {nullptr, prep_read, -1},    // read
+    {write, prep_write, -1},     // write
+    {nullptr, prep_close, -1},   // close
+    {sleep, nullptr, -1},        // sleep
+    {nullptr, prep_accept, 1},   // accept
+    {connect, prep_connect, 3},  // connect
+    {nullptr, prep_send, -1},    // send
+    {nullptr, prep_recv, 4},     // recv
+    {printf, nullptr, -1},       // printf
+    {socket, prep_socket, -1},   // socket
+    {bind, prep_bind, -1},       // bind
+    {listen, prep_listen, -1},   // listen
+    {strlen, nullptr, -1},       // strlen
+    {mmap, nullptr, -1},         // mmap
+    {munmap, nullptr, -1},       // munmap
+    {madvise, nullptr, -1},      // madvise
+};
+static_assert(std::size(SyscallTable::Handlers) == ir::Syscalls.size(), "every built-in syscall needs a handler");
+
+// Runs built-in syscall `index` on the `num_args` arguments on top of the stack, then pops them along with
+// `extra_pops` values below them and pushes the result unless the coroutine was parked
+void VM::run_syscall(Coroutine &coro, size_t index, size_t num_args, size_t extra_pops) {
+    auto &stack = coro.stack;
+    Args args(stack.data() + stack.size() - num_args, num_args);
+    const auto &handler = SyscallTable::Handlers[index];
+    Value result;
+    SyscallStatus status = handler.run ? handler.run(*this, coro, args, result) : SyscallStatus::Submit;
+
+    if (status == SyscallStatus::Submit) {
+        // Armed as a linked timeout; the operation then completes with -ECANCELED if the deadline passes first
+        int64_t deadline_ms = 0;
+        if (handler.deadline_arg >= 0 && (size_t)handler.deadline_arg < args.size()) {
+            deadline_ms = args[handler.deadline_arg].i64_value();
         }
-        case 7: {  // SEND
-            int fd = (int)args_ref[1].i64_value();
-            const void *buf =
-                (args_ref[2].type == ValueType::String) ? (const void *)args_ref[2].as.str : args_ref[2].as.ptr;
-            int len = (int)args_ref[3].i64_value();
-            int flags = (int)args_ref[4].i64_value();
-            io_uring_prep_send(sqe, fd, buf, len, flags);
-            break;
+        if (deadline_ms > 0 && io_uring_sq_space_left(&m_ring) < 2) {
+            io_uring_submit(&m_ring);
         }
-        case 8: {  // RECV
-            int fd = (int)args_ref[1].i64_value();
-            void *buf = args_ref[2].as.ptr;
-            int len = (int)args_ref[3].i64_value();
-            int flags = (int)args_ref[4].i64_value();
-            io_uring_prep_recv(sqe, fd, buf, len, flags);
-            break;
+        struct io_uring_sqe *sqe = handler.prep ? io_uring_get_sqe(&m_ring) : nullptr;
+        if (!sqe) {
+            result = Value(handler.prep ? -1 : -2);
+            status = SyscallStatus::Done;
+        } else {
+            coro.pending_args.assign(std::make_move_iterator(args.begin()), std::make_move_iterator(args.end()));
+            handler.prep(*this, coro, coro.pending_args, sqe);
+            io_uring_sqe_set_data(sqe, (void *)(uintptr_t)coro.id);
+            if (deadline_ms > 0) {
+                io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+                struct io_uring_sqe *timeout_sqe = io_uring_get_sqe(&m_ring);
+                set_timespec(coro.timeout, deadline_ms);
+                io_uring_prep_link_timeout(timeout_sqe, &coro.timeout, 0);
+                io_uring_sqe_set_data(timeout_sqe, (void *)(uintptr_t)IgnoredTag);
+            }
+            io_uring_submit(&m_ring);
+            coro.waiting_for_io = true;
+            status = SyscallStatus::Parked;
         }
-        default:
-            coro.stack.push_back(Value(-2));
-            coro.pending_args.clear();
-            return;
     }
 
-    io_uring_sqe_set_data(sqe, (void *)(uintptr_t)coro.id);
-    io_uring_submit(&m_ring);
-    coro.waiting_for_io = true;
+    stack.erase(stack.end() - (std::ptrdiff_t)(num_args + extra_pops), stack.end());
+    if (status == SyscallStatus::Done) stack.push_back(std::move(result));
+}
+
+// SYSCALL: the id and arguments are on the stack and nothing about them was checked at compile time
+void VM::submit_syscall(Coroutine &coro, uint8_t num_args) {
+    auto &stack = coro.stack;
+    if (num_args == 0) {
+        stack.push_back(Value(-1));
+        return;
+    }
+    int64_t id = stack[stack.size() - num_args].i64_value();
+    std::span<const Value> args(stack.data() + stack.size() - num_args + 1, num_args - 1);
+
+    if (id >= HostSyscallBase) {
+        // Host functions run synchronously on the calling coroutine
+        size_t index = (size_t)(id - HostSyscallBase);
+        bool registered = index < m_host_functions.size() && m_host_functions[index];
+        Value result = registered ? m_host_functions[index](args) : Value(-2);
+        stack.erase(stack.end() - num_args, stack.end());
+        stack.push_back(std::move(result));
+        return;
+    }
+
+    int index = ir::find_syscall(id);
+    if (index < 0) {
+        stack.erase(stack.end() - num_args, stack.end());
+        stack.push_back(Value(-2));
+        return;
+    }
+    check_args(ir::Syscalls[index], args);
+    run_syscall(coro, (size_t)index, num_args - 1, 1);
 }
 
 }  // namespace ether::vm
@@ -0,0 +1,170 @@
+// Checks the embedding API end to end: loading scripts and images, calling into them, host functions and the errors
+// an embedder sees. Run from the repository root (ctest does), so scripts can include the standard library.
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+
+#include "common/error.hpp"
+#include "engine/engine.hpp"
+#include "ir/bytecode_file.hpp"
+#include "ir/ir_gen.hpp"
+#include "lexer/lexer.hpp"
+#include "parser/include_graph.hpp"
+#include "sema/analyzer.hpp"
+
+using ether::Engine;
+using ether::vm::Value;
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string &what) {
+    if (!ok) {
+        std::cerr << "FAIL: " << what << std::endl;
+        failures++;
+    }
+}
+
+void check_value(const Value &value, int64_t expected, const std::string &what) {
+    check(value.i64_value() == expected,
+          what + ": expected " + std::to_string(expected) + ", got " + std::to_string(value.i64_value()));
+}
+
+// Passes when `fn` throws an E whose message contains `message`
+template <typename E>
+void check_throws(const std::function<void()> &fn, const std::string &message, const std::string &what) {
+    try {
+        fn();
+    } catch (const E &e) {
+        check(std::string(e.what()).find(message) != std::string::npos,
+              what + ": unexpected message \"" + e.what() + "\"");
+        return;
+    } catch (const std::exception &e) {
+        check(false, what + ": wrong exception type, \"" + e.what() + "\"");
+        return;
+    }
+    check(false, what + ": nothing was thrown");
+}
+
+std::string temp_path(const std::string &name) {
+    return "/tmp/ether_engine_test_" + std::to_string(getpid()) + "_" + name;
+}
+
+void write_file(const std::string &path, const std::string &content) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << content;
+}
+
+// Compiles `source` the way the engine does and saves it as a .ethc image
+void write_image(const std::string &path, const std::string &source) {
+    ether::lexer::Lexer lexer(source, "image.eth");
+    auto tokens = lexer.tokenize();
+    auto program_ast = ether::parser::parse_with_includes(tokens, "image.eth");
+    ether::sema::Analyzer analyzer;
+    analyzer.analyze(*program_ast);
+    ether::ir_gen::IRGenerator ir_gen(false, true);
+    ether::ir::BytecodeImage image{ir_gen.generate(*program_ast), false, {}};
+    ether::ir::write_bytecode_file(path, image);
+}
+
+const char *Counter = R"(
+i64 count = 10;
+
+i64 bump(i64 by) {
+    count = count + by;
+    return count;
+}
+
+i64 twice(i64 x) { return syscall(1000, x); }
+
+i32 fail() {
+    string s = "ab";
+    return s[5];
+}
+)";
+
+void test_call_and_globals() {
+    Engine engine;
+    engine.register_function(1000, [](std::span<const Value> args) { return Value(args[0].i64_value() * 2); });
+    engine.load_source(Counter);
+    check(engine.has_function("bump"), "bump is found");
+    check(!engine.has_function("missing"), "missing is not found");
+    check_value(engine.call("bump", {Value((int64_t)1)}), 11, "first call");
+    check_value(engine.call("bump", {Value((int64_t)5)}), 16, "globals are kept between calls");
+    check_value(engine.call("twice", {Value((int64_t)21)}), 42, "host function");
+
+    // Reloading starts over with fresh globals, and keeps the host functions
+    engine.load_source(Counter);
+    check_value(engine.call("bump", {Value((int64_t)1)}), 11, "globals reset by a reload");
+    check_value(engine.call("twice", {Value((int64_t)4)}), 8, "host function kept across a reload");
+
+    // A function registered after loading is usable at once, and replaces the old one for later loads too
+    engine.register_function(1000, [](std::span<const Value> args) { return Value(args[0].i64_value() * 3); });
+    check_value(engine.call("twice", {Value((int64_t)4)}), 12, "host function replaced while loaded");
+    engine.load_source(Counter);
+    check_value(engine.call("twice", {Value((int64_t)4)}), 12, "replaced host function after a reload");
+}
+
+void test_errors() {
+    Engine engine;
+    check_throws<std::runtime_error>([&] { engine.call("bump"); }, "No program loaded", "call before load");
+    check_throws<ether::CompilerError>([&] { engine.load_source("i64 broken( { return 1; }"); }, "",
+                                       "invalid source");
+    check_throws<ether::CompilerError>([&] { engine.load_source("i64 f() { return g(); }"); }, "Undefined function",
+                                       "semantic error");
+
+    engine.register_function(1000, [](std::span<const Value> args) { return Value(args[0].i64_value()); });
+    engine.load_source(Counter);
+    check_throws<std::runtime_error>([&] { engine.call("missing"); }, "Undefined function: missing",
+                                     "call to a missing function");
+    check_throws<std::runtime_error>([&] { engine.call("bump"); }, "Function expects 1 arguments, got 0",
+                                     "too few arguments");
+    check_throws<std::runtime_error>([&] { engine.call("fail"); }, "out of bounds", "runtime error in the script");
+    check_value(engine.call("bump", {Value((int64_t)1)}), 11, "calls work again after a runtime error");
+
+    check_throws<std::runtime_error>([&] { engine.load_file(temp_path("missing.eth")); }, "Could not open file",
+                                     "missing source file");
+    std::string bogus = temp_path("bogus.ethc");
+    write_file(bogus, "not an image");
+    check_throws<std::runtime_error>([&] { engine.load_file(bogus); }, "Invalid bytecode file", "corrupt image");
+    std::remove(bogus.c_str());
+}
+
+void test_load_file() {
+    Engine engine;
+    engine.register_function(1000, [](std::span<const Value> args) { return Value(args[0].i64_value() * 2); });
+
+    std::string source = temp_path("script.eth");
+    write_file(source, std::string("#include \"std/io.eth\"\n") + Counter);
+    engine.load_file(source);
+    check_value(engine.call("bump", {Value((int64_t)2)}), 12, "source file");
+    std::remove(source.c_str());
+
+    std::string image = temp_path("script.ethc");
+    write_image(image, Counter);
+    engine.load_file(image);
+    check(engine.has_function("bump"), "bump is found in the image");
+    check_value(engine.call("bump", {Value((int64_t)3)}), 13, "image");
+    check_value(engine.call("bump", {Value((int64_t)3)}), 16, "globals are kept between calls into an image");
+    check_value(engine.call("twice", {Value((int64_t)5)}), 10, "host function from an image");
+    std::remove(image.c_str());
+}
+
+}  // namespace
+
+int main() {
+    test_call_and_globals();
+    test_errors();
+    test_load_file();
+    if (failures > 0) {
+        std::cerr << failures << " engine check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All engine checks passed" << std::endl;
+    return 0;
+}